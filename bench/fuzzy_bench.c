@@ -0,0 +1,97 @@
+#define _DEFAULT_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include "fuzzy.h"
+#include "line_list.h"
+
+/*
+ * Times the fuzzy filter over the lines of a file, typically saved grep
+ * output, as if QUERY was typed one character at a time.
+ *
+ * usage: fuzzy_bench FILE QUERY [THREADS]
+ *
+ * Each keystroke is timed with the incremental update (only the previous
+ * matches are scored again) and with every line scored from scratch.
+ */
+
+static double now_ms() {
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0;
+}
+
+static void run(const char *label, line_list_t *lines, const char *query, int threads, int incremental) {
+    fuzzy_t *fuzzy = fuzzy_init(threads);
+    char typed[FUZZY_MAX_QUERY];
+    double start, elapsed, total = 0, worst = 0;
+    size_t i;
+
+    // the first update computes the signatures, as when results arrive
+    start = now_ms();
+    fuzzy_update(fuzzy, lines, "");
+    printf("%-12s threads %2d  index %8.1f ms\n", label, threads, now_ms() - start);
+
+    for (i = 1; i <= strlen(query) && i < sizeof(typed); i++) {
+        memcpy(typed, query, i);
+        typed[i] = '\0';
+        if (!incremental) {
+            // a different query forces every line to be scored again
+            fuzzy_update(fuzzy, lines, "\x7f");
+        }
+        start = now_ms();
+        fuzzy_update(fuzzy, lines, typed);
+        elapsed = now_ms() - start;
+        total += elapsed;
+        worst = elapsed > worst ? elapsed : worst;
+        printf("%-12s threads %2d  %-16s %8.1f ms  %9d matches\n", label, threads, typed, elapsed, fuzzy->match_count);
+    }
+    printf("%-12s threads %2d  total %8.1f ms  worst keystroke %8.1f ms\n\n", label, threads, total, worst);
+    fuzzy_deallocate(&fuzzy);
+}
+
+int main(int argc, char **argv) {
+    line_list_t *lines;
+    FILE *f;
+    char *line = NULL;
+    size_t size = 0;
+    ssize_t len;
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int threads = cpus > 0 ? (int)cpus : 1;
+
+    if (argc < 3) {
+        fprintf(stderr, "usage: %s FILE QUERY [THREADS]\n", argv[0]);
+        return 1;
+    }
+    if (argc > 3) {
+        threads = atoi(argv[3]);
+    }
+    if ((f = fopen(argv[1], "r")) == NULL) {
+        perror(argv[1]);
+        return 1;
+    }
+
+    lines = line_list_init();
+    while ((len = getline(&line, &size, f)) > 0) {
+        if (line[len - 1] == '\n') {
+            len--;
+        }
+        line_list_add(lines, len, line);
+    }
+    free(line);
+    fclose(f);
+    printf("%d lines\n\n", lines->length);
+
+    run("incremental", lines, argv[2], 1, 1);
+    run("from scratch", lines, argv[2], 1, 0);
+    if (threads > 1) {
+        run("incremental", lines, argv[2], threads, 1);
+        run("from scratch", lines, argv[2], threads, 0);
+    }
+
+    line_list_deallocate(&lines);
+    return 0;
+}
@@ -0,0 +1,196 @@
+#define _XOPEN_SOURCE 600
+#define _DEFAULT_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <termios.h>
+#include <sys/ioctl.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <limits.h>
+
+/*
+ * Measures how long rtgrep takes to echo a keystroke while searches and
+ * other processes compete for the CPU.
+ *
+ * usage: latency_bench RTGREP DIR QUERY LOAD [RTGREP OPTIONS...]
+ *
+ * RTGREP is started on a pseudo terminal in DIR, next to LOAD processes
+ * spinning on the CPU. QUERY is typed one character at a time, every
+ * KEY_INTERVAL_MS, so a search of the whole tree starts after each
+ * keystroke and is still running when the next one arrives. QUERY should
+ * match nothing in DIR: then the first thing rtgrep draws after a keystroke
+ * is the keystroke itself, and the time until it appears is its latency.
+ * The CPU time of the UI process is reported too, and the CPU time the
+ * load processes got, which is what searches take from other work.
+ */
+
+#define KEY_INTERVAL_MS 300
+#define MAX_KEYS 256
+#define MAX_LOAD 64
+#define STARTUP_MS 500
+
+static double now_ms() {
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0;
+}
+
+/*
+ * Reads and drops whatever rtgrep draws for up to timeout ms. Returns the
+ * time the first byte arrived, or -1 when nothing did.
+ */
+static double drain(int fd, double timeout) {
+    struct pollfd pfd = { fd, POLLIN, 0 };
+    char buffer[4096];
+    double deadline = now_ms() + timeout, first = -1, left;
+
+    while ((left = deadline - now_ms()) > 0) {
+        if (poll(&pfd, 1, (int)left + 1) <= 0) {
+            continue;
+        }
+        if (read(fd, buffer, sizeof(buffer)) <= 0) {
+            break;
+        }
+        if (first < 0) {
+            first = now_ms();
+        }
+    }
+    return first;
+}
+
+static double cpu_time_ms(pid_t pid) {
+    char path[64], stat[1024], *p;
+    unsigned long utime, stime;
+    FILE *f;
+
+    snprintf(path, sizeof(path), "/proc/%d/stat", (int)pid);
+    if ((f = fopen(path, "r")) == NULL) {
+        return -1;
+    }
+    p = fgets(stat, sizeof(stat), f);
+    fclose(f);
+    // the fields after the command name, which may contain spaces
+    if (p == NULL || (p = strrchr(stat, ')')) == NULL ||
+        sscanf(p + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu", &utime, &stime) != 2) {
+        return -1;
+    }
+    return (utime + stime) * 1000.0 / sysconf(_SC_CLK_TCK);
+}
+
+static pid_t start_rtgrep(int master, char **argv) {
+    struct winsize size = { 24, 80, 0, 0 };
+    pid_t pid = fork();
+    int slave;
+
+    if (pid == 0) {
+        setsid();
+        slave = open(ptsname(master), O_RDWR);
+        ioctl(slave, TIOCSCTTY, 0);
+        ioctl(slave, TIOCSWINSZ, &size);
+        dup2(slave, STDIN_FILENO);
+        dup2(slave, STDOUT_FILENO);
+        dup2(slave, STDERR_FILENO);
+        close(slave);
+        close(master);
+        setenv("TERM", "xterm", 1);
+        execv(argv[0], argv);
+        _exit(127);
+    }
+    return pid;
+}
+
+static int compare(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+int main(int argc, char **argv) {
+    pid_t load[MAX_LOAD], rtgrep;
+    double latency[MAX_KEYS], sent, echoed, total = 0, cpu, load_cpu = 0;
+    char *rtgrep_argv[64], rtgrep_path[PATH_MAX];
+    const char *query;
+    int master, load_count, key_count, i;
+
+    if (argc < 5 || argc - 3 > (int)(sizeof(rtgrep_argv) / sizeof(rtgrep_argv[0]))) {
+        fprintf(stderr, "usage: %s RTGREP DIR QUERY LOAD [RTGREP OPTIONS...]\n", argv[0]);
+        return 1;
+    }
+    query = argv[3];
+    load_count = atoi(argv[4]);
+    load_count = load_count < 0 ? 0 : load_count > MAX_LOAD ? MAX_LOAD : load_count;
+    key_count = strlen(query) < MAX_KEYS ? (int)strlen(query) : MAX_KEYS;
+    if (realpath(argv[1], rtgrep_path) == NULL) {
+        perror(argv[1]);
+        return 1;
+    }
+    if (chdir(argv[2]) != 0) {
+        perror(argv[2]);
+        return 1;
+    }
+
+    for (i = 0; i < load_count; i++) {
+        if ((load[i] = fork()) == 0) {
+            for (;;) {
+            }
+        }
+    }
+
+    rtgrep_argv[0] = rtgrep_path;
+    for (i = 5; i < argc; i++) {
+        rtgrep_argv[i - 4] = argv[i];
+    }
+    rtgrep_argv[argc - 4] = NULL;
+
+    master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0) {
+        perror("posix_openpt");
+        return 1;
+    }
+    rtgrep = start_rtgrep(master, rtgrep_argv);
+    drain(master, STARTUP_MS);
+    if (waitpid(rtgrep, NULL, WNOHANG) != 0) {
+        fprintf(stderr, "%s did not start\n", rtgrep_path);
+        key_count = 0;
+    }
+
+    for (i = 0; i < key_count; i++) {
+        sent = now_ms();
+        if (write(master, query + i, 1) != 1) {
+            key_count = i;
+            break;
+        }
+        echoed = drain(master, KEY_INTERVAL_MS);
+        latency[i] = echoed < 0 ? KEY_INTERVAL_MS : echoed - sent;
+        total += latency[i];
+        printf("key %-3d %c %8.2f ms\n", i + 1, query[i], latency[i]);
+    }
+    cpu = cpu_time_ms(rtgrep);
+    for (i = 0; i < load_count; i++) {
+        load_cpu += cpu_time_ms(load[i]);
+    }
+
+    if (write(master, "\033", 1) == 1) {
+        drain(master, 1500);
+    }
+    kill(rtgrep, SIGTERM);
+    waitpid(rtgrep, NULL, 0);
+    for (i = 0; i < load_count; i++) {
+        kill(load[i], SIGKILL);
+        waitpid(load[i], NULL, 0);
+    }
+
+    if (key_count > 0) {
+        qsort(latency, key_count, sizeof(double), compare);
+        printf("load %d  keys %d  avg %.2f ms  p50 %.2f ms  p95 %.2f ms  max %.2f ms  ui cpu %.0f ms  load cpu %.0f ms\n",
+               load_count, key_count, total / key_count, latency[key_count / 2],
+               latency[(key_count * 95) / 100 < key_count ? (key_count * 95) / 100 : key_count - 1],
+               latency[key_count - 1], cpu, load_cpu);
+    }
+    return 0;
+}
@@ -1,64 +1,138 @@
-let g:rtgrep_grep_command = "rtgrep -g \"rg --vimgrep --color=always\""
-let g:rtgrep_temp_file = "/tmp/rtgrep_output.txt"
+" Runs rtgrep in a terminal window and fills the quickfix list while you
+" type. rtgrep writes its results as JSON events (see -o in the manual) to
+" a FIFO that a reader job forwards to s:OnEvent, so the list always shows
+" the results of the latest query. When rtgrep exits the list is replaced
+" by the results it printed: the selection, the marked results or all of
+" them.
+
+if !exists('g:rtgrep_grep_command')
+    let g:rtgrep_grep_command = "rtgrep -g \"rg --vimgrep --color=always\""
+endif
+" only used by Vim without terminal windows, which reads the events on exit
+if !exists('g:rtgrep_temp_file')
+    let g:rtgrep_temp_file = "/tmp/rtgrep_output.txt"
+endif
+" how often results that arrived are added to the quickfix list
+if !exists('g:rtgrep_update_ms')
+    let g:rtgrep_update_ms = 100
+endif
+
+let s:generation = 0
+let s:pending = []
+let s:timer = -1
+let s:partial = ''
 
 function RealTimeGrep()
-    " Save current directory
-    let saved_dir = getcwd()
-    
-    " Check if we're in neovim or vim
+    let s:generation = 0
+    let s:pending = []
+    let s:partial = ''
+
+    if has('nvim') || (has('terminal') && has('job'))
+        call s:StartStream()
+    else
+        execute '!' . g:rtgrep_grep_command . ' -o ' . shellescape(g:rtgrep_temp_file)
+        if filereadable(g:rtgrep_temp_file)
+            for line in readfile(g:rtgrep_temp_file)
+                call s:OnEvent(line)
+            endfor
+            call delete(g:rtgrep_temp_file)
+        endif
+        call s:Finish()
+    endif
+endfunction
+
+function s:StartStream()
+    let s:fifo = tempname()
+    call system('mkfifo ' . shellescape(s:fifo))
+    if v:shell_error
+        echoerr 'rtgrep: cannot create ' . s:fifo
+        return
+    endif
+    let l:command = g:rtgrep_grep_command . ' -o ' . shellescape(s:fifo)
+
+    call setqflist([], 'r', {'title': 'rtgrep', 'items': []})
+    copen
+    wincmd p
+
+    " the reader exits once rtgrep has closed the stream
     if has('nvim')
-        " Use terminal for neovim
-        execute 'terminal ' . g:rtgrep_grep_command
+        call jobstart(['cat', s:fifo], {'on_stdout': function('s:OnNvimOutput'),
+                    \ 'on_exit': function('s:Finish')})
+        new
+        call termopen(l:command, {'on_exit': function('s:OnNvimTerminalExit', [bufnr('%')])})
         startinsert
-        autocmd TermClose <buffer> call ProcessRGrepResults()
     else
-        " Use shell command for vim (interactive)
-        let l:command_string = '!' . g:rtgrep_grep_command . ' > ' . g:rtgrep_temp_file
-        execute l:command_string
-        call ProcessFileResults(g:rtgrep_temp_file)
+        call job_start(['cat', s:fifo], {'out_mode': 'nl', 'out_cb': function('s:OnVimOutput'),
+                    \ 'close_cb': function('s:Finish')})
+        call term_start([&shell, &shellcmdflag, l:command], {'term_finish': 'close'})
     endif
 endfunction
 
-function ProcessRGrepResults()
-    " Get the terminal buffer number
-    let term_bufnr = bufnr('%')
-    
-    " Get all lines from the terminal buffer
-    let lines = getbufline(term_bufnr, 1, '$')
-    
-    call ProcessGrepOutput(lines)
+function s:OnVimOutput(channel, line)
+    call s:OnEvent(a:line)
 endfunction
 
-function ProcessFileResults(filepath)
-    " Read results from temporary file
-    if filereadable(a:filepath)
-        let lines = readfile(a:filepath)
-        call ProcessGrepOutput(lines)
-        " Clean up temporary file
-        call delete(a:filepath)
-    else
-        echo "No matches found"
-    endif
+" Neovim hands over chunks, the last line of which may be incomplete
+function s:OnNvimOutput(job, data, event)
+    let l:lines = copy(a:data)
+    let l:lines[0] = s:partial . l:lines[0]
+    let s:partial = remove(l:lines, -1)
+    for line in l:lines
+        call s:OnEvent(line)
+    endfor
 endfunction
 
-function ProcessGrepOutput(lines)
-    " Filter out empty lines and terminal prompts/control sequences
-    let filtered_lines = []
-    for line in a:lines
-        " Skip empty lines and lines that don't look like grep results
-        if line =~ '^\s*$' || line =~ '^[^:]*$'
-            continue
-        endif
-        " Look for lines that match the vimgrep format (file:line:column:text)
-        if line =~ ':\d\+:\d\+:'
-            call add(filtered_lines, line)
+function s:OnNvimTerminalExit(bufnr, job, status, event)
+    execute 'bwipeout! ' . a:bufnr
+endfunction
+
+function s:OnEvent(line)
+    if a:line =~# '^\s*$'
+        return
+    endif
+    try
+        let l:event = json_decode(a:line)
+    catch
+        return
+    endtry
+
+    if l:event.event ==# 'start'
+        " results of the previous query that were not shown yet are dropped
+        let s:pending = []
+        let s:generation = l:event.generation
+        call setqflist([], 'r', {'title': 'rtgrep ' . l:event.pattern, 'items': []})
+    elseif l:event.generation != s:generation
+        return
+    elseif l:event.event ==# 'result'
+        call add(s:pending, {'filename': l:event.path, 'lnum': l:event.line,
+                    \ 'col': l:event.column, 'text': l:event.text})
+        if s:timer == -1 && has('timers')
+            let s:timer = timer_start(g:rtgrep_update_ms, function('s:Flush'))
         endif
-    endfor
-    
-    if !empty(filtered_lines)
-        cexpr filtered_lines
-        copen
     else
+        " done, cancelled or truncated
+        call s:Flush()
+    endif
+endfunction
+
+function s:Flush(...)
+    if s:timer != -1
+        call timer_stop(s:timer)
+        let s:timer = -1
+    endif
+    if !empty(s:pending)
+        call setqflist([], 'a', {'items': s:pending})
+        let s:pending = []
+    endif
+endfunction
+
+function s:Finish(...)
+    call s:Flush()
+    if exists('s:fifo')
+        call delete(s:fifo)
+    endif
+    if empty(getqflist())
+        cclose
         echo "No matches found"
     endif
 endfunction
@@ -0,0 +1,140 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "aho_corasick.h"
+
+/*
+ * Build an automaton matching every term at once. Terms past AC_MAX_TERMS
+ * are ignored, empty terms never match.
+ */
+ac_automaton_t* ac_build(char **terms, int term_count) {
+    ac_automaton_t *ac;
+    int *fail, *queue;
+    int max_states = 1;
+    int head = 0, tail = 0;
+    int i, c, state;
+    const unsigned char *p;
+
+    if (term_count > AC_MAX_TERMS) {
+        term_count = AC_MAX_TERMS;
+    }
+    for (i = 0; i < term_count; i++) {
+        max_states += strlen(terms[i]);
+    }
+
+    ac = malloc(sizeof(ac_automaton_t));
+    if (ac == NULL) {
+        printf("ERROR: ac_build: failed to allocate");
+        exit(1);
+    }
+    ac->next = malloc(sizeof(*ac->next) * max_states);
+    ac->out = calloc(max_states, sizeof(uint64_t));
+    fail = calloc(max_states, sizeof(int));
+    queue = malloc(sizeof(int) * max_states);
+    if (ac->next == NULL || ac->out == NULL || fail == NULL || queue == NULL) {
+        printf("ERROR: ac_build: failed to allocate");
+        exit(1);
+    }
+    memset(ac->next[0], -1, sizeof(ac->next[0]));
+    ac->state_count = 1;
+
+    // trie of all terms
+    for (i = 0; i < term_count; i++) {
+        if (terms[i][0] == '\0') {
+            continue;
+        }
+        state = 0;
+        for (p = (const unsigned char *)terms[i]; *p; p++) {
+            if (ac->next[state][*p] == -1) {
+                memset(ac->next[ac->state_count], -1, sizeof(ac->next[0]));
+                ac->next[state][*p] = ac->state_count++;
+            }
+            state = ac->next[state][*p];
+        }
+        ac->out[state] |= (uint64_t)1 << i;
+        ac->lengths[i] = p - (const unsigned char *)terms[i];
+    }
+
+    // breadth first pass computing failure links and filling in the
+    // missing transitions so scanning never has to follow a failure link
+    for (c = 0; c < 256; c++) {
+        if (ac->next[0][c] == -1) {
+            ac->next[0][c] = 0;
+        } else {
+            fail[ac->next[0][c]] = 0;
+            queue[tail++] = ac->next[0][c];
+        }
+    }
+    while (head < tail) {
+        state = queue[head++];
+        ac->out[state] |= ac->out[fail[state]];
+        for (c = 0; c < 256; c++) {
+            int child = ac->next[state][c];
+
+            if (child == -1) {
+                ac->next[state][c] = ac->next[fail[state]][c];
+            } else {
+                fail[child] = ac->next[fail[state]][c];
+                queue[tail++] = child;
+            }
+        }
+    }
+
+    free(fail);
+    free(queue);
+    return ac;
+}
+
+/*
+ * Scan text once and return the set of terms that occur in it.
+ */
+uint64_t ac_scan(const ac_automaton_t *ac, const char *text, size_t len) {
+    const unsigned char *p = (const unsigned char *)text;
+    const unsigned char *end = p + len;
+    uint64_t found = 0;
+    int state = 0;
+
+    while (p < end) {
+        state = ac->next[state][*p++];
+        found |= ac->out[state];
+    }
+    return found;
+}
+
+/*
+ * Find the match that ends first in text, taking the longest term ending
+ * there. Returns its offset and sets match_len, or returns -1 if no term
+ * occurs in text.
+ */
+long ac_find(const ac_automaton_t *ac, const char *text, size_t len, size_t *match_len) {
+    const unsigned char *p = (const unsigned char *)text;
+    uint64_t found;
+    size_t i, longest;
+    int state = 0;
+    int term;
+
+    for (i = 0; i < len; i++) {
+        state = ac->next[state][p[i]];
+        if ((found = ac->out[state]) != 0) {
+            longest = 0;
+            for (term = 0; term < AC_MAX_TERMS; term++) {
+                if ((found >> term & 1) && ac->lengths[term] > longest) {
+                    longest = ac->lengths[term];
+                }
+            }
+            *match_len = longest;
+            return (long)(i + 1 - longest);
+        }
+    }
+    return -1;
+}
+
+void ac_deallocate(ac_automaton_t **ac) {
+    if (ac == NULL || *ac == NULL) {
+        return;
+    }
+    free((*ac)->next);
+    free((*ac)->out);
+    free(*ac);
+    *ac = NULL;
+}
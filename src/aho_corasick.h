@@ -0,0 +1,21 @@
+#ifndef AHO_CORASICK_H
+#define AHO_CORASICK_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define AC_MAX_TERMS 64
+
+typedef struct {
+    int state_count;
+    int (*next)[256];   // complete transition table, failure links folded in
+    uint64_t *out;      // bit i set when term i ends in this state
+    size_t lengths[AC_MAX_TERMS];
+} ac_automaton_t;
+
+ac_automaton_t* ac_build(char **terms, int term_count);
+uint64_t ac_scan(const ac_automaton_t *ac, const char *text, size_t len);
+long ac_find(const ac_automaton_t *ac, const char *text, size_t len, size_t *match_len);
+void ac_deallocate(ac_automaton_t **ac);
+
+#endif
@@ -5,5 +5,9 @@
 #define ANSI_GOTO_POS "\033[%d;%dH"
 #define ANSI_CLEAR_LINE "\033[K"
 #define ANSI_HORIZONTAL_LINE "─"
+#define ANSI_VERTICAL_LINE "│"
+#define ANSI_RESET "\033[m"
+#define ANSI_BOLD "\033[1m"
+#define ANSI_REVERSE "\033[7m"
 
 #endif
\ No newline at end of file
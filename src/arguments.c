@@ -3,8 +3,24 @@
 #include <unistd.h>
 #include <getopt.h>
 #include <stdio.h>
+#include <limits.h>
 #include "arguments.h"
+#include "governor.h"
 
+/*
+ * Parses text as a whole decimal number from min to max into value.
+ * Returns 0, or -1 if text is not such a number.
+ */
+static int parse_number(const char *text, long min, long max, int *value) {
+    char *end;
+    long number = strtol(text, &end, 10);
+
+    if (*text == '\0' || *end != '\0' || number < min || number > max) {
+        return -1;
+    }
+    *value = (int)number;
+    return 0;
+}
 
 arguments_t* get_cli_arguments(int argc, char **argv) {
     int opt;
@@ -16,13 +32,73 @@ arguments_t* get_cli_arguments(int argc, char **argv) {
     parsed_args = malloc(sizeof(arguments_t));
     parsed_args->pattern = NULL;
     parsed_args->grep_command = NULL;
+    parsed_args->use_cache = 0;
+    parsed_args->multi_term = 0;
+    parsed_args->builtin = 0;
+    parsed_args->preview_context = 0;
+    parsed_args->top_k = 0;
+    parsed_args->nice = GOVERNOR_DEFAULT_NICE;
+    parsed_args->max_workers = 0;
+    parsed_args->cgroup = NULL;
+    parsed_args->stream_path = NULL;
 
-    while((opt = getopt(argc, argv, ":g:h")) != -1) {
+    while((opt = getopt(argc, argv, ":g:cmbp:k:n:j:G:o:h")) != -1) {
         switch (opt) {
             case 'g':
                 parsed_args->grep_command = malloc(strlen(optarg) + 1);
                 strcpy(parsed_args->grep_command, optarg);
                 break;
+            case 'c':
+                parsed_args->use_cache = 1;
+                break;
+            case 'm':
+                parsed_args->multi_term = 1;
+                break;
+            case 'b':
+                parsed_args->builtin = 1;
+                break;
+            case 'p':
+                if (parse_number(optarg, 1, INT_MAX, &parsed_args->preview_context) != 0) {
+                    fprintf(stderr, "Option -p requires a positive number of lines.\n");
+                    print_usage(argv[0]);
+                    deallocate_arguments(&parsed_args);
+                    exit(1);
+                }
+                break;
+            case 'k':
+                if (parse_number(optarg, 1, INT_MAX, &parsed_args->top_k) != 0) {
+                    fprintf(stderr, "Option -k requires a positive number of results.\n");
+                    print_usage(argv[0]);
+                    deallocate_arguments(&parsed_args);
+                    exit(1);
+                }
+                break;
+            case 'n':
+                if (parse_number(optarg, 0, GOVERNOR_MAX_NICE, &parsed_args->nice) != 0) {
+                    fprintf(stderr, "Option -n requires a niceness from 0 to %d.\n", GOVERNOR_MAX_NICE);
+                    print_usage(argv[0]);
+                    deallocate_arguments(&parsed_args);
+                    exit(1);
+                }
+                break;
+            case 'j':
+                if (parse_number(optarg, 1, INT_MAX, &parsed_args->max_workers) != 0) {
+                    fprintf(stderr, "Option -j requires a positive number of workers.\n");
+                    print_usage(argv[0]);
+                    deallocate_arguments(&parsed_args);
+                    exit(1);
+                }
+                break;
+            case 'G':
+                free(parsed_args->cgroup);
+                parsed_args->cgroup = malloc(strlen(optarg) + 1);
+                strcpy(parsed_args->cgroup, optarg);
+                break;
+            case 'o':
+                free(parsed_args->stream_path);
+                parsed_args->stream_path = malloc(strlen(optarg) + 1);
+                strcpy(parsed_args->stream_path, optarg);
+                break;
             case 'h':
                 print_usage(argv[0]);
                 deallocate_arguments(&parsed_args);
@@ -66,6 +142,12 @@ void deallocate_arguments(arguments_t ** args) {
         if ((*args)->pattern) {
             free((*args)->pattern);
         }
+        if ((*args)->cgroup) {
+            free((*args)->cgroup);
+        }
+        if ((*args)->stream_path) {
+            free((*args)->stream_path);
+        }
         free(*args);
         *args = NULL;
     }
@@ -81,5 +163,20 @@ void print_usage(const char *program_name) {
     printf("\n");
     printf("Options:\n");
     printf("  -g COMMAND             Custom grep command to use\n");
+    printf("  -c                     Cache results on disk and reuse them across runs\n");
+    printf("  -m                     Treat PATTERN as a multi-term query (see below)\n");
+    printf("  -b                     Search in-process instead of running grep (literal text)\n");
+    printf("  -p LINES               Preview LINES lines of context around the selected result\n");
+    printf("  -k K                   Rank results and keep only the K most relevant\n");
+    printf("  -n NICE                Run searches at niceness NICE, 0 to 19 (default %d)\n", GOVERNOR_DEFAULT_NICE);
+    printf("  -j N                   Use at most N worker threads per search\n");
+    printf("  -G DIR                 Run searches in the cgroup v2 group DIR\n");
+    printf("  -o FILE                Stream results as JSON lines to FILE, a FIFO or /dev/fd/N\n");
     printf("  -h, --help             Show this help message\n");
+    printf("\n");
+    printf("Multi-term queries (-m):\n");
+    printf("  foo bar                Lines containing both foo and bar\n");
+    printf("  foo|bar                Lines containing foo or bar\n");
+    printf("  !foo                   Lines not containing foo\n");
+    printf("  Terms are literal text, use \\ to escape a space, | or !\n");
 }
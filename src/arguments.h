@@ -4,6 +4,15 @@
 typedef struct {
     char *grep_command;
     char *pattern;
+    int use_cache;
+    int multi_term;
+    int builtin;
+    int preview_context;   // context lines shown in the preview pane, 0 hides it
+    int top_k;             // keep only the K best ranked results, 0 keeps every result
+    int nice;              // niceness of backend searches, 0 runs them at normal priority
+    int max_workers;       // worker threads per search, 0 means one per CPU
+    char *cgroup;          // cgroup v2 directory to run backend searches in
+    char *stream_path;     // file or FIFO to write the JSON lines event stream to
 } arguments_t;
 
 arguments_t* get_cli_arguments(int argc, char **argv);
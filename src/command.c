@@ -0,0 +1,183 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include "command.h"
+
+static void append(char **buf, size_t *len, size_t *cap, const char *s) {
+    size_t n = strlen(s);
+
+    if (*len + n + 1 > *cap) {
+        while (*len + n + 1 > *cap) {
+            *cap *= 2;
+        }
+        *buf = realloc(*buf, *cap);
+        if (*buf == NULL) {
+            printf("ERROR: command_build: failed to allocate");
+            exit(1);
+        }
+    }
+    memcpy(*buf + *len, s, n + 1);
+    *len += n;
+}
+
+/*
+ * Quote s for /bin/sh using single quotes, so the pattern reaches the
+ * backend exactly as typed. Caller frees the result.
+ */
+char* command_shell_quote(const char *s) {
+    size_t quotes = 0;
+    const char *p;
+    char *quoted, *out;
+
+    for (p = s; *p; p++) {
+        if (*p == '\'') {
+            quotes++;
+        }
+    }
+
+    // each ' becomes '\'' (3 extra bytes), plus the surrounding quotes
+    quoted = malloc(strlen(s) + quotes * 3 + 3);
+    if (quoted == NULL) {
+        printf("ERROR: command_shell_quote: failed to allocate");
+        exit(1);
+    }
+
+    out = quoted;
+    *out++ = '\'';
+    for (p = s; *p; p++) {
+        if (*p == '\'') {
+            memcpy(out, "'\\''", 4);
+            out += 4;
+        } else {
+            *out++ = *p;
+        }
+    }
+    *out++ = '\'';
+    *out = '\0';
+
+    return quoted;
+}
+
+/*
+ * Build the shell command line for a backend search.
+ * With no targets the search covers the current directory. With explicit
+ * targets /dev/null is appended so backends always print file names, even
+ * when only one file is being searched. Caller frees the result.
+ */
+char* command_build(const char *command, const char *pattern, line_list_t *targets) {
+    line_list_t *patterns = line_list_init();
+    char *buf;
+
+    line_list_add(patterns, strlen(pattern), (char *)pattern);
+    buf = command_build_patterns(command, patterns, targets);
+    line_list_deallocate(&patterns);
+
+    return buf;
+}
+
+/*
+ * Like command_build, but matching any of several patterns. A single pattern
+ * is passed as is, several are passed as "-e PATTERN" options, which grep
+ * and rg both understand.
+ */
+char* command_build_patterns(const char *command, line_list_t *patterns, line_list_t *targets) {
+    size_t len = 0, cap = 256;
+    char *buf = malloc(cap);
+    char *quoted;
+    int i;
+
+    if (buf == NULL) {
+        printf("ERROR: command_build: failed to allocate");
+        exit(1);
+    }
+    buf[0] = '\0';
+
+    append(&buf, &len, &cap, command);
+    for (i = 0; i < patterns->length; i++) {
+        append(&buf, &len, &cap, patterns->length > 1 ? " -e " : " ");
+        quoted = command_shell_quote(patterns->lines[i]);
+        append(&buf, &len, &cap, quoted);
+        free(quoted);
+    }
+
+    if (targets == NULL || targets->length == 0) {
+        append(&buf, &len, &cap, " .");
+        return buf;
+    }
+
+    for (i = 0; i < targets->length; i++) {
+        append(&buf, &len, &cap, " ");
+        quoted = command_shell_quote(targets->lines[i]);
+        append(&buf, &len, &cap, quoted);
+        free(quoted);
+    }
+    append(&buf, &len, &cap, " /dev/null");
+
+    return buf;
+}
+
+static int set_case(int options, int flag) {
+    return (options & ~(COMMAND_IGNORE_CASE | COMMAND_SMART_CASE)) | flag;
+}
+
+/*
+ * Works out from the options of a grep-like command whether it searches
+ * for fixed strings (fgrep, -F, --fixed-strings) and whether it ignores
+ * case (-i, --ignore-case) or uses smart case (-S, --smart-case). The
+ * last case option wins. Short options may be combined, as in "-rniF".
+ * Returns a combination of the COMMAND_ flags.
+ */
+int command_options(const char *command) {
+    const char *word = command, *end, *p, *name;
+    int options = 0;
+    size_t len;
+
+    while (*word) {
+        while (*word == ' ' || *word == '\t') {
+            word++;
+        }
+        for (end = word; *end && *end != ' ' && *end != '\t'; end++) {
+        }
+        len = end - word;
+
+        if (word == command) {
+            // the program itself, possibly given with its path
+            for (name = p = word; p < end; p++) {
+                if (*p == '/') {
+                    name = p + 1;
+                }
+            }
+            if (end - name == 5 && strncmp(name, "fgrep", 5) == 0) {
+                options |= COMMAND_FIXED_STRINGS;
+            }
+        } else if (len == 2 && strncmp(word, "--", 2) == 0) {
+            break;
+        } else if (len > 2 && strncmp(word, "--", 2) == 0) {
+            if (len == 15 && strncmp(word, "--fixed-strings", len) == 0) {
+                options |= COMMAND_FIXED_STRINGS;
+            } else if (len == 13 && strncmp(word, "--ignore-case", len) == 0) {
+                options = set_case(options, COMMAND_IGNORE_CASE);
+            } else if (len == 12 && strncmp(word, "--smart-case", len) == 0) {
+                options = set_case(options, COMMAND_SMART_CASE);
+            } else if ((len == 16 && strncmp(word, "--case-sensitive", len) == 0)
+                       || (len == 16 && strncmp(word, "--no-ignore-case", len) == 0)) {
+                options = set_case(options, 0);
+            }
+        } else if (len > 1 && word[0] == '-') {
+            // stop at the first character that is not a letter, which
+            // starts the value of an option such as -m1 or -g*.c
+            for (p = word + 1; p < end && isalpha((unsigned char)*p); p++) {
+                if (*p == 'F') {
+                    options |= COMMAND_FIXED_STRINGS;
+                } else if (*p == 'i') {
+                    options = set_case(options, COMMAND_IGNORE_CASE);
+                } else if (*p == 'S') {
+                    options = set_case(options, COMMAND_SMART_CASE);
+                }
+            }
+        }
+        word = end;
+    }
+    return options;
+}
@@ -0,0 +1,16 @@
+#ifndef COMMAND_H
+#define COMMAND_H
+
+#include "line_list.h"
+
+// how a backend command matches patterns, see command_options
+#define COMMAND_FIXED_STRINGS 1
+#define COMMAND_IGNORE_CASE 2
+#define COMMAND_SMART_CASE 4
+
+char* command_shell_quote(const char *s);
+char* command_build(const char *command, const char *pattern, line_list_t *targets);
+char* command_build_patterns(const char *command, line_list_t *patterns, line_list_t *targets);
+int command_options(const char *command);
+
+#endif
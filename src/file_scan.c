@@ -0,0 +1,206 @@
+#define _DEFAULT_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "file_scan.h"
+
+/*
+ * Read fd to EOF into a malloc'd buffer, FILE_SCAN_READ_BLOCK bytes per
+ * read(). size_hint is only used to size the buffer up front (special
+ * files report 0).
+ */
+static int read_all(int fd, size_t size_hint, file_view_t *view, file_scan_stats_t *stats) {
+    size_t capacity = size_hint + 1;
+    size_t length = 0;
+    char *data = malloc(capacity);
+    ssize_t n;
+
+    if (data == NULL) {
+        return -1;
+    }
+
+    for (;;) {
+        size_t want = FILE_SCAN_READ_BLOCK;
+
+        if (length + want > capacity) {
+            capacity = (length + want) * 2;
+            char *grown = realloc(data, capacity);
+            if (grown == NULL) {
+                free(data);
+                return -1;
+            }
+            data = grown;
+        }
+        n = read(fd, data + length, want);
+        stats->reads++;
+        if (n < 0) {
+            free(data);
+            return -1;
+        }
+        if (n == 0) {
+            break;
+        }
+        length += n;
+    }
+
+    view->data = data;
+    view->size = length;
+    view->mapped = 0;
+    return 0;
+}
+
+/*
+ * Open path for scanning. In FILE_SCAN_MMAP mode regular files are mapped
+ * read only and advised for a sequential pass; small files are cheaper to
+ * read() than to map and special files cannot be mapped, so both fall back
+ * to reading. Returns 0 on success, -1 on failure.
+ */
+int file_view_open(file_view_t *view, const char *path, file_scan_mode_t mode, file_scan_stats_t *stats) {
+    struct stat st;
+    void *map;
+    int fd, result;
+
+    view->data = NULL;
+    view->size = 0;
+    view->mapped = 0;
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return -1;
+    }
+    stats->opens++;
+
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return -1;
+    }
+
+    if (mode == FILE_SCAN_MMAP && S_ISREG(st.st_mode) && st.st_size >= FILE_SCAN_SMALL_FILE) {
+        map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        stats->mmaps++;
+        if (map != MAP_FAILED) {
+            madvise(map, st.st_size, MADV_SEQUENTIAL);
+            madvise(map, st.st_size, MADV_WILLNEED);
+            stats->madvises += 2;
+            close(fd);
+            view->data = map;
+            view->size = st.st_size;
+            view->mapped = 1;
+            stats->bytes += view->size;
+            return 0;
+        }
+    }
+
+    result = read_all(fd, S_ISREG(st.st_mode) ? (size_t)st.st_size : 0, view, stats);
+    close(fd);
+    if (result == 0) {
+        stats->bytes += view->size;
+    }
+    return result;
+}
+
+void file_view_close(file_view_t *view) {
+    if (view->mapped) {
+        munmap((void *)view->data, view->size);
+    } else {
+        free((void *)view->data);
+    }
+    view->data = NULL;
+    view->size = 0;
+    view->mapped = 0;
+}
+
+/*
+ * Treat files with a NUL byte near the start as binary, like grep and rg.
+ */
+int file_view_is_binary(const file_view_t *view) {
+    size_t probe = view->size < FILE_SCAN_BINARY_PROBE ? view->size : FILE_SCAN_BINARY_PROBE;
+
+    return probe > 0 && memchr(view->data, '\0', probe) != NULL;
+}
+
+static void add_match(scan_result_t *result, const char *line, size_t len, long lineno) {
+    if (result->length == result->capacity) {
+        result->capacity = result->capacity ? result->capacity * 2 : 16;
+        result->matches = realloc(result->matches, sizeof(scan_match_t) * result->capacity);
+        if (result->matches == NULL) {
+            printf("ERROR: file_scan_chunk: failed to allocate");
+            exit(1);
+        }
+    }
+    result->matches[result->length].line = line;
+    result->matches[result->length].len = len;
+    result->matches[result->length].lineno = lineno;
+    result->length++;
+}
+
+/*
+ * Scan the lines that start in [start, end) of the view for any term of ac.
+ * Every line matches if ac is NULL.
+ * A line that starts in the chunk is scanned to its end even if that lies
+ * past end, so splitting a file into chunks never loses or duplicates a
+ * line. Matches point into the view.
+ */
+void file_scan_chunk(const file_view_t *view, size_t start, size_t end, const ac_automaton_t *ac, scan_result_t *result) {
+    const unsigned char *data = (const unsigned char *)view->data;
+    const unsigned char *p, *line_start, *limit, *file_end;
+
+    if (end > view->size) {
+        end = view->size;
+    }
+    if (start > 0 && start < end && data[start - 1] != '\n') {
+        const unsigned char *nl = memchr(data + start, '\n', end - start);
+        if (nl == NULL) {
+            return;
+        }
+        start = nl + 1 - data;
+    }
+    if (start >= end) {
+        return;
+    }
+
+    line_start = data + start;
+    limit = data + end;
+    file_end = data + view->size;
+
+    // line ends are found with memchr and the automaton restarts on every
+    // line, so its inner loop has no newline check
+    while (line_start < limit) {
+        const unsigned char *line_end = memchr(line_start, '\n', file_end - line_start);
+        uint64_t found = 0;
+        int state = 0;
+
+        if (line_end == NULL) {
+            line_end = file_end;
+        }
+        if (ac == NULL) {
+            found = 1;
+        } else {
+            for (p = line_start; p < line_end; p++) {
+                state = ac->next[state][*p];
+                found |= ac->out[state];
+            }
+        }
+
+        result->lines++;
+        if (found) {
+            add_match(result, (const char *)line_start, line_end - line_start, result->lines);
+        }
+        if (line_end == file_end) {
+            break;
+        }
+        line_start = line_end + 1;
+    }
+}
+
+void scan_result_clear(scan_result_t *result) {
+    free(result->matches);
+    result->matches = NULL;
+    result->length = 0;
+    result->capacity = 0;
+    result->lines = 0;
+}
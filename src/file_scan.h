@@ -0,0 +1,49 @@
+#ifndef FILE_SCAN_H
+#define FILE_SCAN_H
+
+#include <stddef.h>
+#include "aho_corasick.h"
+
+#define FILE_SCAN_SMALL_FILE (16 * 1024)
+#define FILE_SCAN_READ_BLOCK (128 * 1024)
+#define FILE_SCAN_BINARY_PROBE 8192
+
+typedef enum {
+    FILE_SCAN_MMAP,     // map regular files, read() small and special files
+    FILE_SCAN_READ      // read() everything through a fixed size block
+} file_scan_mode_t;
+
+typedef struct {
+    long opens;
+    long reads;
+    long mmaps;
+    long madvises;
+    long bytes;
+} file_scan_stats_t;
+
+typedef struct {
+    const char *data;
+    size_t size;
+    int mapped;
+} file_view_t;
+
+typedef struct {
+    const char *line;   // points into the file view, copy it to keep it
+    size_t len;
+    long lineno;        // 1 based, relative to the start of the chunk
+} scan_match_t;
+
+typedef struct {
+    int length;
+    int capacity;
+    scan_match_t *matches;
+    long lines;         // lines starting in the chunk
+} scan_result_t;
+
+int file_view_open(file_view_t *view, const char *path, file_scan_mode_t mode, file_scan_stats_t *stats);
+void file_view_close(file_view_t *view);
+int file_view_is_binary(const file_view_t *view);
+void file_scan_chunk(const file_view_t *view, size_t start, size_t end, const ac_automaton_t *ac, scan_result_t *result);
+void scan_result_clear(scan_result_t *result);
+
+#endif
@@ -0,0 +1,524 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include "fuzzy.h"
+
+#define MAX_THREADS 64
+
+#define SCORE_MATCH 16
+#define SCORE_GAP_START 3
+#define SCORE_GAP_EXTENSION 1
+#define BONUS_CONSECUTIVE 4
+#define BONUS_PATH 12           // first character of a path component
+#define BONUS_WORD 8            // first character of a word
+#define BONUS_CAMEL 6           // upper case letter after a lower case one
+
+typedef struct {
+    fuzzy_t *fuzzy;
+    const line_list_t *lines;
+    const char *query;
+    size_t query_length;
+    uint64_t query_mask;
+    int fold;
+    int first_new;      // lines from here on have no signature yet
+    int resume_count;   // work items continuing the previous match
+    size_t resume_length;
+    int from;
+    int to;
+    pthread_t thread;
+} fuzzy_batch_t;
+
+static uint64_t mask_table[256];
+static pthread_once_t mask_table_once = PTHREAD_ONCE_INIT;
+
+static int mask_bit(unsigned char c) {
+    if (c >= 'A' && c <= 'Z') {
+        c += 'a' - 'A';
+    }
+    if (c >= 'a' && c <= 'z') {
+        return c - 'a';
+    }
+    if (c >= '0' && c <= '9') {
+        return 26 + c - '0';
+    }
+    return 36 + c % 28;
+}
+
+static void build_mask_table() {
+    int c;
+
+    for (c = 0; c < 256; c++) {
+        mask_table[c] = (uint64_t)1 << mask_bit((unsigned char)c);
+    }
+}
+
+static char upper(char c) {
+    return c >= 'a' && c <= 'z' ? c - ('a' - 'A') : c;
+}
+
+static int is_alnum(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9');
+}
+
+static int folds_case(const char *query, size_t query_length) {
+    size_t j;
+
+    for (j = 0; j < query_length; j++) {
+        if (query[j] >= 'A' && query[j] <= 'Z') {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/*
+ * Returns 1 if every character of small appears in big in order, in which
+ * case every line matching big also matches small.
+ */
+static int is_subsequence(const char *small, size_t small_length, const char *big, size_t big_length) {
+    size_t i, j = 0;
+
+    for (i = 0; i < big_length && j < small_length; i++) {
+        if (big[i] == small[j]) {
+            j++;
+        }
+    }
+    return j == small_length;
+}
+
+/*
+ * Returns 1 if p is part of a color escape ("\033[" parameters, final
+ * byte) in line. Escapes only contain digits, ';' and a final byte besides
+ * their first two bytes, so this only looks back over those.
+ */
+static int in_escape(const char *line, const char *p) {
+    if (*p == '\033') {
+        return 1;
+    }
+    if (*p == '[') {
+        return p > line && p[-1] == '\033';
+    }
+    if (!(*p >= '0' && *p <= '9') && *p != ';' && !(*p >= '@' && *p <= '~')) {
+        return 0;
+    }
+    for (p--; p >= line && ((*p >= '0' && *p <= '9') || *p == ';'); p--) {
+    }
+    return p > line && *p == '[' && p[-1] == '\033';
+}
+
+/*
+ * The text character before p, skipping color escapes, or '\0' at the
+ * start of the line.
+ */
+static char previous_char(const char *line, const char *p) {
+    for (p--; p >= line; p--) {
+        if (!in_escape(line, p)) {
+            return *p;
+        }
+        while (p > line && *p != '\033') {
+            p--;
+        }
+    }
+    return '\0';
+}
+
+/*
+ * Next occurrence of c at or after p outside of color escapes, or NULL.
+ * strchr and strpbrk skip over the text between occurrences a vector at a
+ * time.
+ */
+static const char* find_next(const char *line, const char *p, char c, int fold) {
+    char both[3] = {c, upper(c), '\0'};
+
+    for (;;) {
+        p = fold && both[1] != c ? strpbrk(p, both) : strchr(p, c);
+        if (p == NULL || !in_escape(line, p)) {
+            return p;
+        }
+        p++;
+    }
+}
+
+/*
+ * Last occurrence of c before end outside of color escapes, or NULL.
+ */
+static const char* find_previous(const char *line, const char *end, char c, int fold) {
+    const char *lower_hit, *upper_hit, *p;
+
+    for (;;) {
+        lower_hit = memrchr(line, c, end - line);
+        p = lower_hit ? lower_hit + 1 : line;
+        // only an upper case hit after the lower case one matters
+        upper_hit = fold && upper(c) != c ? memrchr(p, upper(c), end - p) : NULL;
+        p = upper_hit ? upper_hit : lower_hit;
+        if (p == NULL || !in_escape(line, p)) {
+            return p;
+        }
+        end = p;
+    }
+}
+
+/*
+ * Number of text characters in [from, to), not counting color escapes.
+ */
+static size_t text_length(const char *from, const char *to) {
+    size_t length = to - from;
+    const char *p;
+
+    while ((p = memchr(from, '\033', to - from)) != NULL) {
+        for (from = p + 1; from < to && !(*from >= '@' && *from <= '~' && *from != '['); from++) {
+        }
+        if (from < to) {
+            from++;
+        }
+        length -= from - p;
+    }
+    return length;
+}
+
+static int bonus_for(char previous, char c) {
+    if (previous == '\0' || previous == '/') {
+        return BONUS_PATH;
+    }
+    if (!is_alnum(previous) && is_alnum(c)) {
+        return BONUS_WORD;
+    }
+    if (previous >= 'a' && previous <= 'z' && c >= 'A' && c <= 'Z') {
+        return BONUS_CAMEL;
+    }
+    return 0;
+}
+
+/*
+ * Signature of the characters in text: one bit per letter (either case),
+ * per digit, and for each of a few buckets of the other bytes. A line can
+ * only match a query whose signature is a subset of its own.
+ */
+uint64_t fuzzy_mask(const char *text, size_t len) {
+    const unsigned char *p = (const unsigned char *)text;
+    uint64_t mask = 0;
+    size_t i;
+
+    pthread_once(&mask_table_once, build_mask_table);
+    for (i = 0; i < len; i++) {
+        mask |= mask_table[p[i]];
+    }
+    return mask;
+}
+
+/*
+ * Signature of the text of a NUL terminated line, without looking for its
+ * end first. Color escapes are skipped like in text_length, otherwise every
+ * colored line would have the bits of '[', ';', 'm' and the color digits.
+ */
+static uint64_t line_mask(const char *line) {
+    const unsigned char *p = (const unsigned char *)line;
+    uint64_t mask = 0;
+
+    for (; *p; p++) {
+        if (*p == '\033') {
+            for (p++; *p && !(*p >= '@' && *p <= '~' && *p != '['); p++) {
+            }
+            if (*p == '\0') {
+                break;
+            }
+            continue;
+        }
+        mask |= mask_table[*p];
+    }
+    return mask;
+}
+
+/*
+ * Score line against query as described for fuzzy_score. The first matched
+ * characters of query are known to end at offset *end in line, the rest
+ * are looked for from there; *end is set to where the whole query ends.
+ */
+static int score_line(const char *query, size_t query_length, int fold, const char *line, size_t matched, int *end_offset) {
+    const char *positions[FUZZY_MAX_QUERY];
+    const char *p;
+    int score = 0;
+    size_t j, gap;
+
+    if (query_length == 0) {
+        return 0;
+    }
+
+    for (p = line + *end_offset, j = matched; j < query_length; j++, p++) {
+        if ((p = find_next(line, p, query[j], fold)) == NULL) {
+            return -1;
+        }
+    }
+    *end_offset = (int)(p - line);
+
+    // walk back from the end of the match, taking the last occurrence of
+    // every character, which gives the shortest window
+    positions[query_length - 1] = p - 1;
+    for (j = query_length - 1; j > 0; j--) {
+        positions[j - 1] = find_previous(line, positions[j], query[j - 1], fold);
+    }
+
+    for (j = 0; j < query_length; j++) {
+        p = positions[j];
+        if (j > 0 && (gap = text_length(positions[j - 1] + 1, p)) == 0) {
+            score += BONUS_CONSECUTIVE;
+        } else if (j > 0) {
+            score -= SCORE_GAP_START + (int)(gap - 1) * SCORE_GAP_EXTENSION;
+        }
+        score += SCORE_MATCH + bonus_for(previous_char(line, p), *p);
+    }
+
+    if (score < 0) {
+        return 0;
+    }
+    return score < FUZZY_MAX_SCORE ? score : FUZZY_MAX_SCORE - 1;
+}
+
+/*
+ * Score line against query, or return -1 if the characters of query do not
+ * appear in line in order. Color escapes in line are ignored. The query is
+ * case insensitive unless it contains an upper case letter.
+ * The shortest window ending at the first complete match is scored: every
+ * matched character scores, more so at the start of a path component or
+ * word and when it follows the previous match, and every skipped character
+ * costs a little.
+ */
+int fuzzy_score(const char *query, size_t query_length, const char *line) {
+    int end = 0;
+
+    return score_line(query, query_length, folds_case(query, query_length), line, 0, &end);
+}
+
+static void* score_batch(void *arg) {
+    fuzzy_batch_t *batch = arg;
+    fuzzy_t *fuzzy = batch->fuzzy;
+    int k;
+
+    for (k = batch->from; k < batch->to; k++) {
+        int index = fuzzy->work[k];
+        const char *line = batch->lines->lines[index];
+
+        if (index >= batch->first_new) {
+            fuzzy->masks[index] = line_mask(line);
+        }
+        if ((fuzzy->masks[index] & batch->query_mask) != batch->query_mask) {
+            fuzzy->scores[k] = -1;
+        } else {
+            fuzzy->scores[k] = score_line(batch->query, batch->query_length, batch->fold, line,
+                                          k < batch->resume_count ? batch->resume_length : 0, &fuzzy->ends[k]);
+        }
+    }
+    return NULL;
+}
+
+static void* grow(void *data, int *capacity, int needed, size_t size) {
+    if (needed <= *capacity) {
+        return data;
+    }
+    *capacity = needed * 2;
+    data = realloc(data, size * *capacity);
+    if (data == NULL) {
+        printf("ERROR: fuzzy_update: failed to allocate");
+        exit(1);
+    }
+    return data;
+}
+
+/*
+ * Score the count lines listed in fuzzy->work, splitting them into batches
+ * of at least FUZZY_BATCH_SIZE lines for the worker threads. The first
+ * resume_count lines carry on from the end of their previous match.
+ */
+static void score_work(fuzzy_t *fuzzy, const line_list_t *lines, const char *query, size_t query_length, int count,
+                       int resume_count) {
+    fuzzy_batch_t batches[MAX_THREADS];
+    int batch_count = (count + FUZZY_BATCH_SIZE - 1) / FUZZY_BATCH_SIZE;
+    int i;
+
+    if (batch_count > fuzzy->thread_count) {
+        batch_count = fuzzy->thread_count;
+    }
+    if (batch_count < 1) {
+        batch_count = 1;
+    }
+
+    for (i = 0; i < batch_count; i++) {
+        batches[i].fuzzy = fuzzy;
+        batches[i].lines = lines;
+        batches[i].query = query;
+        batches[i].query_length = query_length;
+        batches[i].query_mask = fuzzy_mask(query, query_length);
+        batches[i].fold = folds_case(query, query_length);
+        batches[i].first_new = fuzzy->scanned;
+        batches[i].resume_count = resume_count;
+        batches[i].resume_length = fuzzy->query_length;
+        batches[i].from = (int)((long long)count * i / batch_count);
+        batches[i].to = (int)((long long)count * (i + 1) / batch_count);
+    }
+
+    if (batch_count == 1) {
+        score_batch(&batches[0]);
+        return;
+    }
+    for (i = 0; i < batch_count; i++) {
+        pthread_create(&batches[i].thread, NULL, score_batch, &batches[i]);
+    }
+    for (i = 0; i < batch_count; i++) {
+        pthread_join(batches[i].thread, NULL);
+    }
+}
+
+/*
+ * Order the matches by score, best last, keeping list order between equal
+ * scores. Scores are small integers, so a counting sort does this in
+ * linear time.
+ */
+static void sort_matches(fuzzy_t *fuzzy) {
+    int counts[FUZZY_MAX_SCORE + 1];
+    int i;
+
+    fuzzy->order = grow(fuzzy->order, &fuzzy->order_capacity, fuzzy->match_count, sizeof(int));
+    memset(counts, 0, sizeof(counts));
+    for (i = 0; i < fuzzy->match_count; i++) {
+        counts[fuzzy->matches[i].score + 1]++;
+    }
+    for (i = 1; i <= FUZZY_MAX_SCORE; i++) {
+        counts[i] += counts[i - 1];
+    }
+    for (i = 0; i < fuzzy->match_count; i++) {
+        fuzzy->order[counts[fuzzy->matches[i].score]++] = fuzzy->matches[i].index;
+    }
+}
+
+fuzzy_t* fuzzy_init(int thread_count) {
+    fuzzy_t *fuzzy = calloc(1, sizeof(fuzzy_t));
+
+    if (fuzzy == NULL) {
+        printf("ERROR: fuzzy_init: failed to allocate");
+        exit(1);
+    }
+    if (thread_count < 1) {
+        thread_count = 1;
+    }
+    pthread_once(&mask_table_once, build_mask_table);
+    fuzzy->thread_count = thread_count > MAX_THREADS ? MAX_THREADS : thread_count;
+    return fuzzy;
+}
+
+/*
+ * Bring the matches up to date with query and with the lines added to
+ * lines since the last update. A query that keeps every character of the
+ * previous one in order can only drop matches, so only the previous
+ * matches are scored again; otherwise every line is. Lines added since the
+ * last update are always scored. Returns 1 if the matches changed.
+ */
+int fuzzy_update(fuzzy_t *fuzzy, const line_list_t *lines, const char *query) {
+    size_t query_length = strlen(query);
+    int changed, narrowing, resuming, count = 0, keep = 0, resume_count = 0, needed, i;
+
+    if (query_length >= FUZZY_MAX_QUERY) {
+        query_length = FUZZY_MAX_QUERY - 1;
+    }
+    if (lines->length < fuzzy->scanned) {
+        // the list was cleared, its lines have nothing to do with ours
+        fuzzy_reset(fuzzy);
+    }
+
+    changed = query_length != fuzzy->query_length || strncmp(query, fuzzy->query, query_length) != 0;
+    narrowing = is_subsequence(fuzzy->query, fuzzy->query_length, query, query_length);
+    resuming = narrowing && strncmp(query, fuzzy->query, fuzzy->query_length) == 0
+               && folds_case(query, query_length) == folds_case(fuzzy->query, fuzzy->query_length);
+    if (!changed && lines->length == fuzzy->scanned) {
+        return 0;
+    }
+
+    needed = lines->length - fuzzy->scanned + (changed && !narrowing ? fuzzy->scanned : fuzzy->match_count);
+    if (needed > fuzzy->work_capacity) {
+        fuzzy->work_capacity = needed * 2;
+        fuzzy->work = realloc(fuzzy->work, sizeof(int) * fuzzy->work_capacity);
+        fuzzy->scores = realloc(fuzzy->scores, sizeof(int) * fuzzy->work_capacity);
+        fuzzy->ends = realloc(fuzzy->ends, sizeof(int) * fuzzy->work_capacity);
+        if (fuzzy->work == NULL || fuzzy->scores == NULL || fuzzy->ends == NULL) {
+            printf("ERROR: fuzzy_update: failed to allocate");
+            exit(1);
+        }
+    }
+    fuzzy->masks = grow(fuzzy->masks, &fuzzy->mask_capacity, lines->length, sizeof(uint64_t));
+
+    if (!changed) {
+        keep = fuzzy->match_count;
+    } else if (narrowing) {
+        for (i = 0; i < fuzzy->match_count; i++) {
+            fuzzy->ends[count] = resuming ? fuzzy->matches[i].end : 0;
+            fuzzy->work[count++] = fuzzy->matches[i].index;
+        }
+        resume_count = resuming ? count : 0;
+    } else {
+        for (i = 0; i < fuzzy->scanned; i++) {
+            fuzzy->ends[count] = 0;
+            fuzzy->work[count++] = i;
+        }
+    }
+    for (i = fuzzy->scanned; i < lines->length; i++) {
+        fuzzy->ends[count] = 0;
+        fuzzy->work[count++] = i;
+    }
+
+    score_work(fuzzy, lines, query, query_length, count, resume_count);
+
+    // work is in list order, so the matches stay in list order
+    fuzzy->matches = grow(fuzzy->matches, &fuzzy->match_capacity, keep + count, sizeof(fuzzy_match_t));
+    fuzzy->match_count = keep;
+    for (i = 0; i < count; i++) {
+        if (fuzzy->scores[i] >= 0) {
+            fuzzy->matches[fuzzy->match_count].index = fuzzy->work[i];
+            fuzzy->matches[fuzzy->match_count].score = fuzzy->scores[i];
+            fuzzy->matches[fuzzy->match_count].end = fuzzy->ends[i];
+            fuzzy->match_count++;
+        }
+    }
+    sort_matches(fuzzy);
+
+    memcpy(fuzzy->query, query, query_length);
+    fuzzy->query[query_length] = '\0';
+    fuzzy->query_length = query_length;
+    fuzzy->scanned = lines->length;
+    return 1;
+}
+
+/*
+ * Replace out with the matching lines of lines, best last. out only refers
+ * to the lines, which must outlive it.
+ */
+void fuzzy_results(const fuzzy_t *fuzzy, const line_list_t *lines, line_list_t *out) {
+    int i;
+
+    line_list_clear(out);
+    for (i = 0; i < fuzzy->match_count; i++) {
+        line_list_add_ref(out, lines->lines[fuzzy->order[i]]);
+    }
+}
+
+/*
+ * Forget every line, for when the list being filtered is rebuilt.
+ */
+void fuzzy_reset(fuzzy_t *fuzzy) {
+    fuzzy->scanned = 0;
+    fuzzy->match_count = 0;
+}
+
+void fuzzy_deallocate(fuzzy_t **fuzzy) {
+    if (fuzzy == NULL || *fuzzy == NULL) {
+        return;
+    }
+    free((*fuzzy)->masks);
+    free((*fuzzy)->matches);
+    free((*fuzzy)->order);
+    free((*fuzzy)->work);
+    free((*fuzzy)->scores);
+    free((*fuzzy)->ends);
+    free(*fuzzy);
+    *fuzzy = NULL;
+}
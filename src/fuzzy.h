@@ -0,0 +1,60 @@
+#ifndef FUZZY_H
+#define FUZZY_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "line_list.h"
+
+#define FUZZY_MAX_QUERY 256
+#define FUZZY_MAX_SCORE 4096
+#define FUZZY_BATCH_SIZE 16384     // lines scored per worker thread at least
+
+/*
+ * Fuzzy filter over a list of result lines. A line matches when the
+ * characters of the query appear in it in order; matches at the start of
+ * a path component or word and runs of consecutive characters score
+ * higher. Every line gets a 64 bit signature of the characters it contains
+ * the first time it is seen, so most lines are rejected with a single AND
+ * on every keystroke. The remaining lines are scored in batches spread
+ * over worker threads. When the query only grows, only the lines that
+ * matched the previous query are looked at again, and when it grows at the
+ * end their match carries on from where the previous one ended.
+ */
+
+typedef struct {
+    int index;          // position in the filtered list
+    int score;
+    int end;            // offset just past the first complete match in the line
+} fuzzy_match_t;
+
+typedef struct {
+    int thread_count;
+    char query[FUZZY_MAX_QUERY];
+    size_t query_length;
+
+    uint64_t *masks;            // signature of every line scanned so far
+    int scanned;                // lines of the list looked at so far
+    int mask_capacity;
+
+    fuzzy_match_t *matches;     // lines matching the query, in list order
+    int match_count;
+    int match_capacity;
+    int *order;                 // indices of the matches, best last
+    int order_capacity;
+
+    // scratch for an update
+    int *work;
+    int *scores;
+    int *ends;
+    int work_capacity;
+} fuzzy_t;
+
+fuzzy_t* fuzzy_init(int thread_count);
+uint64_t fuzzy_mask(const char *text, size_t len);
+int fuzzy_score(const char *query, size_t query_length, const char *line);
+int fuzzy_update(fuzzy_t *fuzzy, const line_list_t *lines, const char *query);
+void fuzzy_results(const fuzzy_t *fuzzy, const line_list_t *lines, line_list_t *out);
+void fuzzy_reset(fuzzy_t *fuzzy);
+void fuzzy_deallocate(fuzzy_t **fuzzy);
+
+#endif
@@ -0,0 +1,90 @@
+#define _DEFAULT_SOURCE
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include "governor.h"
+
+#define IOPRIO_WHO_PROCESS 1
+#define IOPRIO_CLASS_BE 2
+#define IOPRIO_CLASS_IDLE 3
+#define IOPRIO_CLASS_SHIFT 13
+
+void governor_init(governor_t *governor, int nice, int max_workers, const char *cgroup) {
+    if (nice < 0) {
+        nice = 0;
+    }
+    governor->nice = nice > GOVERNOR_MAX_NICE ? GOVERNOR_MAX_NICE : nice;
+    governor->max_workers = max_workers > 0 ? max_workers : 0;
+    snprintf(governor->cgroup, sizeof(governor->cgroup), "%s", cgroup ? cgroup : "");
+}
+
+/*
+ * Number of worker threads a search may start: one per CPU, capped by
+ * max_workers.
+ */
+int governor_workers(const governor_t *governor) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int workers = cpus > 0 ? (int)cpus : 1;
+
+    if (governor->max_workers > 0 && governor->max_workers < workers) {
+        workers = governor->max_workers;
+    }
+    return workers;
+}
+
+/*
+ * I/O priority matching a niceness, as the kernel derives it for processes
+ * without one: best effort, level (nice + 20) / 5. The highest niceness,
+ * GOVERNOR_MAX_NICE, puts I/O in the idle class, which only gets the disk
+ * when nobody else wants it.
+ */
+int governor_ioprio(int nice) {
+    if (nice >= GOVERNOR_MAX_NICE) {
+        return IOPRIO_CLASS_IDLE << IOPRIO_CLASS_SHIFT;
+    }
+    return (IOPRIO_CLASS_BE << IOPRIO_CLASS_SHIFT) | ((nice + 20) / 5);
+}
+
+static int join_cgroup(const char *cgroup) {
+    char path[GOVERNOR_MAX_PATH + 16];
+    FILE *procs;
+    int result;
+
+    snprintf(path, sizeof(path), "%s/cgroup.procs", cgroup);
+    if ((procs = fopen(path, "w")) == NULL) {
+        return -1;
+    }
+    // writing 0 moves the writing process
+    result = fprintf(procs, "0\n") < 0;
+    result |= fclose(procs) != 0;
+    return result ? -1 : 0;
+}
+
+/*
+ * Called in a freshly forked backend process before it starts searching.
+ * Lowers the CPU and I/O priority of the process and moves it into the
+ * cgroup. Everything the backend starts inherits these. Returns the
+ * GOVERNOR_*_FAILED bits of whatever could not be applied; the backend
+ * runs either way.
+ */
+int governor_enter_backend(const governor_t *governor) {
+    int failed = 0;
+
+    if (governor->nice > 0) {
+        if (setpriority(PRIO_PROCESS, 0, governor->nice) != 0) {
+            failed |= GOVERNOR_NICE_FAILED;
+        }
+#ifdef SYS_ioprio_set
+        if (syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, 0, governor_ioprio(governor->nice)) != 0) {
+            failed |= GOVERNOR_IOPRIO_FAILED;
+        }
+#else
+        failed |= GOVERNOR_IOPRIO_FAILED;
+#endif
+    }
+    if (governor->cgroup[0] != '\0' && join_cgroup(governor->cgroup) != 0) {
+        failed |= GOVERNOR_CGROUP_FAILED;
+    }
+    return failed;
+}
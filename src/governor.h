@@ -0,0 +1,31 @@
+#ifndef GOVERNOR_H
+#define GOVERNOR_H
+
+#define GOVERNOR_DEFAULT_NICE 10
+#define GOVERNOR_MAX_NICE 19
+#define GOVERNOR_MAX_PATH 4096
+
+// what governor_enter_backend could not apply
+#define GOVERNOR_NICE_FAILED 1
+#define GOVERNOR_IOPRIO_FAILED 2
+#define GOVERNOR_CGROUP_FAILED 4
+
+/*
+ * Limits on the resources backend searches may take from the rest of the
+ * machine. Backends run at a lower CPU and I/O priority, optionally inside
+ * a cgroup v2 group carrying CPU and I/O limits, and with a bounded number
+ * of worker threads. The process running the UI is never changed.
+ */
+
+typedef struct {
+    int nice;                       // niceness of backend work, 0 leaves it alone
+    int max_workers;                // worker threads per search, 0 means one per CPU
+    char cgroup[GOVERNOR_MAX_PATH]; // cgroup v2 directory for backends, empty for none
+} governor_t;
+
+void governor_init(governor_t *governor, int nice, int max_workers, const char *cgroup);
+int governor_workers(const governor_t *governor);
+int governor_ioprio(int nice);
+int governor_enter_backend(const governor_t *governor);
+
+#endif
@@ -4,8 +4,10 @@
 #include "line_list.h"
 
 #define INIT_LINES_SIZE 500
+#define LINE_BLOCK_SIZE 65536
 
-void deallocate_lines_contents(int length, char** lines);
+void deallocate_blocks(line_block_t *blocks);
+char* allocate_line(line_list_t *l, size_t size);
 
 line_list_t* line_list_init() {
     line_list_t *l;
@@ -21,14 +23,34 @@ line_list_t* line_list_init() {
     l->lines = malloc(sizeof(char*) * INIT_LINES_SIZE);
     l->length = 0;
     l->capacity = INIT_LINES_SIZE;
+    l->blocks = NULL;
 
     return l;
 }
 
+/*
+ * Append a copy of line, cut at s bytes or at its first NUL.
+ */
 void line_list_add(line_list_t *l, int s, char line[]) {
+    char *line_copy;
+    char *nul = memchr(line, '\0', s);
+
+    if (nul != NULL) {
+        s = nul - line;
+    }
+    line_copy = allocate_line(l, s + 1);
+    memcpy(line_copy, line, s);
+    line_copy[s] = '\0';
+    line_list_add_ref(l, line_copy);
+}
+
+/*
+ * Append line without copying it. The line must outlive the list, or at
+ * least the next line_list_clear.
+ */
+void line_list_add_ref(line_list_t *l, char *line) {
     char **new_lines;
     char **lines_to_free;
-    char *line_copy;
     int i;
 
     // Expand lines if needed
@@ -46,32 +68,57 @@ void line_list_add(line_list_t *l, int s, char line[]) {
         free(lines_to_free);
     }
     
-    line_copy = malloc(sizeof(char) * (s + 1));
-    strncpy(line_copy, line, s);
-    line_copy[s] = '\0';
-    l->lines[l->length] = line_copy;
+    l->lines[l->length] = line;
     l->length++;
 }
 
 void line_list_clear(line_list_t *l) {
-    deallocate_lines_contents(l->length, l->lines);
+    deallocate_blocks(l->blocks);
+    l->blocks = NULL;
     l->length = 0;
 }
 
 void line_list_deallocate(line_list_t **l) {
-    deallocate_lines_contents((*l)->length, (*l)->lines);
+    deallocate_blocks((*l)->blocks);
     free((*l)->lines);
     free((*l));
     *l = NULL; 
 }
 
+/*
+ * Carve size bytes out of the current block, starting a new block when it
+ * is full. Lines larger than a block get a block of their own.
+ */
+char* allocate_line(line_list_t *l, size_t size) {
+    line_block_t *block = l->blocks;
+    size_t block_size;
+
+    if (block == NULL || block->size - block->used < size) {
+        block_size = size > LINE_BLOCK_SIZE ? size : LINE_BLOCK_SIZE;
+        block = malloc(sizeof(line_block_t) + block_size);
+        if (block == NULL) {
+            printf("ERROR: line_list_add: failed to allocate");
+            exit(1);
+        }
+        block->used = 0;
+        block->size = block_size;
+        block->next = l->blocks;
+        l->blocks = block;
+    }
+
+    block->used += size;
+    return block->data + block->used - size;
+}
+
 /* 
- * Deallocate the contents of char* list lines.
+ * Deallocate a chain of line blocks.
  */
-void deallocate_lines_contents(int length, char** lines){
-    int i;
+void deallocate_blocks(line_block_t *blocks) {
+    line_block_t *next;
 
-    for (i = 0; i < length; i++) {
-        free(lines[i]);
+    while (blocks != NULL) {
+        next = blocks->next;
+        free(blocks);
+        blocks = next;
     }
 }
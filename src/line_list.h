@@ -1,14 +1,30 @@
 #ifndef LINE_LIST_H
 #define LINE_LIST_H
 
+#include <stddef.h>
+
+/*
+ * Lines are copied into large blocks owned by the list instead of being
+ * allocated one by one, so a line of any length costs one copy and clearing
+ * the list frees a handful of blocks.
+ */
+typedef struct line_block {
+    struct line_block *next;
+    size_t used;
+    size_t size;
+    char data[];
+} line_block_t;
+
 typedef struct {
     int length;
     int capacity;
     char **lines;
+    line_block_t *blocks;   // most recent block first
 } line_list_t;
 
 line_list_t* line_list_init();
 void line_list_add(line_list_t *l, int s, char line[]);
+void line_list_add_ref(line_list_t *l, char *line);
 void line_list_clear(line_list_t *l);
 void line_list_deallocate(line_list_t **l);
 
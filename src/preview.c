@@ -0,0 +1,251 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "preview.h"
+
+static void close_file(preview_file_t *file) {
+    if (file->view.data) {
+        file_view_close(&file->view);
+    }
+    free(file->line_offsets);
+    free(file->path);
+    memset(file, 0, sizeof(preview_file_t));
+}
+
+/*
+ * Map path and record where every line starts. line_offsets[i] is the start
+ * of line i (0 based) and line i ends one byte before line_offsets[i + 1].
+ */
+static int open_file(preview_t *preview, preview_file_t *file, const char *path, const struct stat *st) {
+    const char *data, *p, *end;
+    long count = 0, i = 0;
+
+    if (file_view_open(&file->view, path, FILE_SCAN_MMAP, &preview->stats) != 0) {
+        return -1;
+    }
+    if (file_view_is_binary(&file->view)) {
+        file_view_close(&file->view);
+        return -1;
+    }
+
+    data = file->view.data;
+    end = data + file->view.size;
+    for (p = data; p < end && (p = memchr(p, '\n', end - p)) != NULL; p++) {
+        count++;
+    }
+    if (file->view.size > 0 && data[file->view.size - 1] != '\n') {
+        count++;
+    }
+
+    file->line_offsets = malloc(sizeof(size_t) * (count + 1));
+    file->line_offsets[0] = 0;
+    for (p = data; p < end && (p = memchr(p, '\n', end - p)) != NULL; p++) {
+        file->line_offsets[++i] = p - data + 1;
+    }
+    if (i < count) {
+        // last line has no trailing newline
+        file->line_offsets[count] = file->view.size + 1;
+    }
+
+    file->path = strdup(path);
+    file->line_count = count;
+    file->mtime_sec = (long long)st->st_mtim.tv_sec;
+    file->mtime_nsec = st->st_mtim.tv_nsec;
+    file->size = st->st_size;
+    return 0;
+}
+
+/*
+ * Returns the mapped file for path, mapping it (and evicting the least
+ * recently used file) if needed. Files that changed on disk are mapped again.
+ */
+static preview_file_t* lookup_file(preview_t *preview, const char *path) {
+    preview_file_t *file = NULL;
+    struct stat st;
+    int i;
+
+    if (stat(path, &st) != 0 || !S_ISREG(st.st_mode)) {
+        return NULL;
+    }
+
+    for (i = 0; i < preview->file_count; i++) {
+        if (strcmp(preview->files[i].path, path) == 0) {
+            file = &preview->files[i];
+            break;
+        }
+    }
+
+    if (file && (file->mtime_sec != (long long)st.st_mtim.tv_sec || file->mtime_nsec != st.st_mtim.tv_nsec
+                 || file->size != st.st_size)) {
+        close_file(file);
+    } else if (file == NULL && preview->file_count < PREVIEW_MAX_FILES) {
+        file = &preview->files[preview->file_count++];
+    } else if (file == NULL) {
+        file = &preview->files[0];
+        for (i = 1; i < preview->file_count; i++) {
+            if (preview->files[i].last_used < file->last_used) {
+                file = &preview->files[i];
+            }
+        }
+        close_file(file);
+    }
+
+    if (file->path == NULL && open_file(preview, file, path, &st) != 0) {
+        // keep the slot empty but valid for the next lookup
+        file->path = strdup("");
+        return NULL;
+    }
+
+    file->last_used = ++preview->clock;
+    return file;
+}
+
+/*
+ * Copy the lines around line (1 based) out of the mapping.
+ */
+static long extract_context(preview_file_t *file, long line, int context, line_list_t *lines) {
+    long first = line - context;
+    long last = line + context;
+    long i;
+
+    if (first < 1) {
+        first = 1;
+    }
+    if (last > file->line_count) {
+        last = file->line_count;
+    }
+
+    for (i = first; i <= last; i++) {
+        size_t start = file->line_offsets[i - 1];
+        size_t len = file->line_offsets[i] - 1 - start;
+
+        if (len > PREVIEW_MAX_LINE_LEN) {
+            len = PREVIEW_MAX_LINE_LEN;
+        }
+        line_list_add(lines, len, (char *)file->view.data + start);
+    }
+    return first;
+}
+
+static void* preview_main(void *arg) {
+    preview_t *preview = arg;
+    char path[PREVIEW_MAX_PATH];
+    preview_file_t *file;
+    line_list_t *lines, *old_lines;
+    long line, first;
+
+    pthread_mutex_lock(&preview->lock);
+    while (!preview->stop) {
+        if (!preview->request_pending) {
+            pthread_cond_wait(&preview->cond, &preview->lock);
+            continue;
+        }
+        strcpy(path, preview->request_path);
+        line = preview->request_line;
+        preview->request_pending = 0;
+        pthread_mutex_unlock(&preview->lock);
+
+        // mapping and indexing happen without the lock held, so the UI
+        // thread never waits on file I/O
+        lines = line_list_init();
+        first = line;
+        if ((file = lookup_file(preview, path)) != NULL) {
+            first = extract_context(file, line, preview->context, lines);
+        }
+
+        pthread_mutex_lock(&preview->lock);
+        old_lines = preview->response_lines;
+        preview->response_lines = lines;
+        strcpy(preview->response_path, path);
+        preview->response_line = line;
+        preview->response_first_line = first;
+        preview->response_ready = 1;
+        pthread_mutex_unlock(&preview->lock);
+
+        line_list_deallocate(&old_lines);
+        pthread_mutex_lock(&preview->lock);
+    }
+    pthread_mutex_unlock(&preview->lock);
+
+    return NULL;
+}
+
+preview_t* preview_init(int context) {
+    preview_t *preview = calloc(1, sizeof(preview_t));
+
+    if (preview == NULL) {
+        printf("ERROR: preview_init: failed to allocate");
+        exit(1);
+    }
+    preview->context = context;
+    preview->response_lines = line_list_init();
+    pthread_mutex_init(&preview->lock, NULL);
+    pthread_cond_init(&preview->cond, NULL);
+    pthread_create(&preview->thread, NULL, preview_main, preview);
+
+    return preview;
+}
+
+/*
+ * Ask for the context around line of path. Never blocks on the worker: a
+ * request that has not been picked up yet is simply replaced.
+ */
+void preview_request(preview_t *preview, const char *path, long line) {
+    pthread_mutex_lock(&preview->lock);
+    snprintf(preview->request_path, sizeof(preview->request_path), "%s", path);
+    preview->request_line = line;
+    preview->request_pending = 1;
+    pthread_cond_signal(&preview->cond);
+    pthread_mutex_unlock(&preview->lock);
+}
+
+/*
+ * Copy out the latest response if there is a new one. Returns 1 and fills
+ * the arguments when a new response was available, 0 otherwise.
+ */
+int preview_poll(preview_t *preview, char *path, size_t path_size, line_list_t *lines, long *first_line, long *line) {
+    int i;
+
+    pthread_mutex_lock(&preview->lock);
+    if (!preview->response_ready) {
+        pthread_mutex_unlock(&preview->lock);
+        return 0;
+    }
+
+    snprintf(path, path_size, "%s", preview->response_path);
+    *first_line = preview->response_first_line;
+    *line = preview->response_line;
+    line_list_clear(lines);
+    for (i = 0; i < preview->response_lines->length; i++) {
+        line_list_add(lines, strlen(preview->response_lines->lines[i]), preview->response_lines->lines[i]);
+    }
+    preview->response_ready = 0;
+    pthread_mutex_unlock(&preview->lock);
+
+    return 1;
+}
+
+void preview_deallocate(preview_t **preview) {
+    int i;
+
+    if (preview == NULL || *preview == NULL) {
+        return;
+    }
+
+    pthread_mutex_lock(&(*preview)->lock);
+    (*preview)->stop = 1;
+    pthread_cond_signal(&(*preview)->cond);
+    pthread_mutex_unlock(&(*preview)->lock);
+    pthread_join((*preview)->thread, NULL);
+
+    for (i = 0; i < (*preview)->file_count; i++) {
+        close_file(&(*preview)->files[i]);
+    }
+    line_list_deallocate(&(*preview)->response_lines);
+    pthread_mutex_destroy(&(*preview)->lock);
+    pthread_cond_destroy(&(*preview)->cond);
+    free(*preview);
+    *preview = NULL;
+}
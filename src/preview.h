@@ -0,0 +1,61 @@
+#ifndef PREVIEW_H
+#define PREVIEW_H
+
+#include <pthread.h>
+#include <sys/types.h>
+#include "file_scan.h"
+#include "line_list.h"
+
+#define PREVIEW_MAX_FILES 8
+#define PREVIEW_MAX_PATH 4096
+#define PREVIEW_MAX_LINE_LEN 1024
+
+/*
+ * Context lines for the preview pane. A worker thread maps the requested
+ * file, indexes its line offsets once and keeps the last few files mapped,
+ * so moving the selection within a file only slices the index.
+ */
+
+typedef struct {
+    char *path;
+    file_view_t view;
+    long long mtime_sec;
+    long mtime_nsec;
+    off_t size;
+    size_t *line_offsets;   // start of every line, plus one past the end
+    long line_count;
+    unsigned long last_used;
+} preview_file_t;
+
+typedef struct {
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int stop;
+    int context;
+
+    // latest request, replaced by newer requests before the worker sees it
+    char request_path[PREVIEW_MAX_PATH];
+    long request_line;
+    int request_pending;
+
+    // latest response
+    char response_path[PREVIEW_MAX_PATH];
+    long response_line;
+    long response_first_line;
+    line_list_t *response_lines;
+    int response_ready;
+
+    // only touched by the worker
+    preview_file_t files[PREVIEW_MAX_FILES];
+    int file_count;
+    unsigned long clock;
+    file_scan_stats_t stats;
+} preview_t;
+
+preview_t* preview_init(int context);
+void preview_request(preview_t *preview, const char *path, long line);
+int preview_poll(preview_t *preview, char *path, size_t path_size, line_list_t *lines, long *first_line, long *line);
+void preview_deallocate(preview_t **preview);
+
+#endif
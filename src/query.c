@@ -0,0 +1,251 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include "query.h"
+#include "result_line.h"
+
+/*
+ * Returns the index of term, adding it if it is new.
+ * Returns -1 once AC_MAX_TERMS distinct terms exist.
+ */
+static int add_term(query_t *query, const char *term, size_t len) {
+    int i;
+
+    for (i = 0; i < query->term_count; i++) {
+        if (strlen(query->terms[i]) == len && strncmp(query->terms[i], term, len) == 0) {
+            return i;
+        }
+    }
+    if (query->term_count == AC_MAX_TERMS) {
+        return -1;
+    }
+
+    query->terms[query->term_count] = malloc(len + 1);
+    memcpy(query->terms[query->term_count], term, len);
+    query->terms[query->term_count][len] = '\0';
+    return query->term_count++;
+}
+
+static void fold_case(char *s, size_t len) {
+    size_t i;
+
+    for (i = 0; i < len; i++) {
+        s[i] = tolower((unsigned char)s[i]);
+    }
+}
+
+/*
+ * Parse text into clauses and build the automaton that matches every term
+ * in a single pass. Empty terms and clauses are ignored. When case is
+ * ignored, ASCII letters match either case.
+ */
+query_t* query_parse(const char *text, query_case_t match_case) {
+    query_t *query;
+    char *term = malloc(strlen(text) + 1);
+    size_t term_len = 0;
+    query_clause_t clause = {0, 0};
+    int at_clause_start = 1;
+    int index;
+    const char *p;
+
+    query = calloc(1, sizeof(query_t));
+    if (query == NULL || term == NULL) {
+        printf("ERROR: query_parse: failed to allocate");
+        exit(1);
+    }
+    query->ignore_case = match_case == QUERY_IGNORE_CASE;
+    if (match_case == QUERY_SMART_CASE) {
+        query->ignore_case = 1;
+        for (p = text; *p; p++) {
+            if (isupper((unsigned char)*p)) {
+                query->ignore_case = 0;
+                break;
+            }
+        }
+    }
+
+    for (p = text; ; p++) {
+        int end_of_term = (*p == '\0' || *p == ' ' || *p == '|');
+
+        if (end_of_term) {
+            if (query->ignore_case) {
+                fold_case(term, term_len);
+            }
+            if (term_len > 0 && (index = add_term(query, term, term_len)) >= 0) {
+                clause.terms |= (uint64_t)1 << index;
+            }
+            term_len = 0;
+        }
+        if (*p == '\0' || *p == ' ') {
+            if (clause.terms && query->clause_count < AC_MAX_TERMS) {
+                query->clauses[query->clause_count++] = clause;
+            }
+            clause.terms = 0;
+            clause.negated = 0;
+            at_clause_start = 1;
+            if (*p == '\0') {
+                break;
+            }
+            continue;
+        }
+        if (*p == '|') {
+            continue;
+        }
+
+        if (*p == '!' && at_clause_start) {
+            clause.negated = 1;
+        } else {
+            if (*p == '\\' && p[1] != '\0') {
+                p++;
+            }
+            term[term_len++] = *p;
+        }
+        at_clause_start = 0;
+    }
+
+    free(term);
+    query->ac = ac_build(query->terms, query->term_count);
+    return query;
+}
+
+/*
+ * Evaluate the query against the set of terms found on a line.
+ */
+int query_matches(const query_t *query, uint64_t found) {
+    int i;
+
+    for (i = 0; i < query->clause_count; i++) {
+        int present = (found & query->clauses[i].terms) != 0;
+
+        if (present == query->clauses[i].negated) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/*
+ * Match the query against the text of a result line, ignoring color escapes
+ * and the leading path and line number.
+ */
+int query_matches_line(query_t *query, const char *line) {
+    size_t needed = strlen(line) + 1;
+    char *content;
+
+    if (needed > query->scratch_size) {
+        query->scratch = realloc(query->scratch, needed);
+        query->scratch_size = needed;
+    }
+    result_line_strip_ansi(line, query->scratch, query->scratch_size);
+    content = (char *)result_line_content(query->scratch);
+    if (query->ignore_case) {
+        fold_case(content, strlen(content));
+    }
+
+    return query_matches(query, ac_scan(query->ac, content, strlen(content)));
+}
+
+/*
+ * Escape term so regex based backends match it literally. A bracket
+ * expression holding a single metacharacter behaves the same in BRE, ERE,
+ * PCRE and Rust regex, so most are wrapped in one rather than backslash
+ * escaped. Brackets themselves cannot be: Rust regex reads "[[]" as an
+ * unclosed nested class, so they are backslash escaped, like the backslash
+ * itself and '^'.
+ * Caller frees the result.
+ */
+char* query_escape_term(const char *term) {
+    char *escaped = malloc(strlen(term) * 3 + 1);
+    char *out = escaped;
+    const char *p;
+
+    for (p = term; *p; p++) {
+        if (strchr("\\^[]", *p)) {
+            *out++ = '\\';
+            *out++ = *p;
+        } else if (strchr(".*+?(){}|$", *p)) {
+            *out++ = '[';
+            *out++ = *p;
+            *out++ = ']';
+        } else {
+            *out++ = *p;
+        }
+    }
+    *out = '\0';
+    return escaped;
+}
+
+/*
+ * Choose the clause the backend searches for and add its terms to terms.
+ * Lines without that clause can never match, so the backend only has to
+ * produce candidates and the automaton does the rest. The first single
+ * term clause is preferred, so once one has been typed, appending further
+ * clauses keeps the backend search unchanged.
+ * If every clause is negated, a single empty term is added: every line is
+ * a candidate. Adds nothing if the query has no clauses.
+ */
+void query_backend_terms(const query_t *query, line_list_t *terms) {
+    const query_clause_t *anchor = NULL;
+    int i;
+
+    for (i = 0; i < query->clause_count; i++) {
+        const query_clause_t *clause = &query->clauses[i];
+
+        if (clause->negated) {
+            continue;
+        }
+        if ((clause->terms & (clause->terms - 1)) == 0) {
+            anchor = clause;
+            break;
+        }
+        if (anchor == NULL) {
+            anchor = clause;
+        }
+    }
+    if (anchor == NULL) {
+        if (query->clause_count > 0) {
+            line_list_add(terms, 0, "");
+        }
+        return;
+    }
+
+    for (i = 0; i < query->term_count; i++) {
+        if (anchor->terms & ((uint64_t)1 << i)) {
+            line_list_add(terms, strlen(query->terms[i]), query->terms[i]);
+        }
+    }
+}
+
+/*
+ * Like query_backend_terms, but escaped for regex based backends. The
+ * empty term stays empty, which grep and rg match on every line.
+ */
+void query_backend_patterns(const query_t *query, line_list_t *patterns) {
+    line_list_t *terms = line_list_init();
+    char *escaped;
+    int i;
+
+    query_backend_terms(query, terms);
+    for (i = 0; i < terms->length; i++) {
+        escaped = query_escape_term(terms->lines[i]);
+        line_list_add(patterns, strlen(escaped), escaped);
+        free(escaped);
+    }
+    line_list_deallocate(&terms);
+}
+
+void query_deallocate(query_t **query) {
+    int i;
+
+    if (query == NULL || *query == NULL) {
+        return;
+    }
+    for (i = 0; i < (*query)->term_count; i++) {
+        free((*query)->terms[i]);
+    }
+    ac_deallocate(&(*query)->ac);
+    free((*query)->scratch);
+    free(*query);
+    *query = NULL;
+}
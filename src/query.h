@@ -0,0 +1,44 @@
+#ifndef QUERY_H
+#define QUERY_H
+
+#include <stdint.h>
+#include "aho_corasick.h"
+#include "line_list.h"
+
+/*
+ * Multi-term queries: space separated clauses must all hold on a line,
+ * "a|b" matches either term and a leading '!' negates a clause.
+ * A backslash makes the next character literal.
+ */
+
+typedef enum {
+    QUERY_MATCH_CASE,
+    QUERY_IGNORE_CASE,
+    QUERY_SMART_CASE    // ignore case unless the query has an upper case letter
+} query_case_t;
+
+typedef struct {
+    uint64_t terms;     // bit set of terms, the clause holds if any is present
+    int negated;
+} query_clause_t;
+
+typedef struct {
+    int term_count;
+    char *terms[AC_MAX_TERMS];
+    int clause_count;
+    query_clause_t clauses[AC_MAX_TERMS];
+    ac_automaton_t *ac;
+    int ignore_case;    // terms are lower case and lines are folded before matching
+    char *scratch;
+    size_t scratch_size;
+} query_t;
+
+query_t* query_parse(const char *text, query_case_t match_case);
+int query_matches(const query_t *query, uint64_t found);
+int query_matches_line(query_t *query, const char *line);
+void query_backend_terms(const query_t *query, line_list_t *terms);
+void query_backend_patterns(const query_t *query, line_list_t *patterns);
+char* query_escape_term(const char *term);
+void query_deallocate(query_t **query);
+
+#endif
@@ -0,0 +1,230 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "rank.h"
+#include "result_line.h"
+
+#define RANK_WORD_BONUS 8.0         // match is a whole word, not part of one
+#define RANK_RECENCY_BONUS 6.0      // file modified just now, halved after a day
+#define RANK_DEPTH_PENALTY 1.0      // per directory below the current one
+#define RANK_PARENT_PENALTY 4.0     // per ".." above the current directory
+#define RANK_OUTSIDE_PENALTY 8.0    // absolute path outside the current directory
+
+rank_t* rank_init(int capacity) {
+    rank_t *rank = calloc(1, sizeof(rank_t));
+
+    if (capacity < 1) {
+        capacity = 1;
+    }
+    if (rank == NULL) {
+        printf("ERROR: rank_init: failed to allocate");
+        exit(1);
+    }
+    rank->entries = malloc(sizeof(rank_entry_t) * capacity);
+    rank->sorted = malloc(sizeof(rank_entry_t) * capacity);
+    if (rank->entries == NULL || rank->sorted == NULL) {
+        printf("ERROR: rank_init: failed to allocate");
+        exit(1);
+    }
+    rank->capacity = capacity;
+    if (getcwd(rank->cwd, sizeof(rank->cwd)) != NULL) {
+        rank->cwd_length = strlen(rank->cwd);
+    }
+    rank->now = time(NULL);
+
+    return rank;
+}
+
+/*
+ * Score how close path is to the current directory: every directory
+ * between them costs a little, leaving the current directory costs more.
+ */
+double rank_path_score(rank_t *rank, const char *path) {
+    double score = 0;
+
+    if (path[0] == '/') {
+        if (rank->cwd_length > 0 && strncmp(path, rank->cwd, rank->cwd_length) == 0
+            && path[rank->cwd_length] == '/') {
+            path += rank->cwd_length + 1;
+        } else {
+            score -= RANK_OUTSIDE_PENALTY;
+            path++;
+        }
+    }
+
+    while (*path) {
+        const char *slash = strchr(path, '/');
+
+        if (slash == NULL) {
+            break;
+        }
+        if (slash - path == 2 && path[0] == '.' && path[1] == '.') {
+            score -= RANK_PARENT_PENALTY;
+        } else if (!(slash - path == 1 && path[0] == '.') && slash != path) {
+            score -= RANK_DEPTH_PENALTY;
+        }
+        path = slash + 1;
+    }
+    return score;
+}
+
+static double recency_score(rank_t *rank, const char *path) {
+    struct stat st;
+    double age_days;
+
+    if (strcmp(path, rank->last_path) == 0) {
+        return rank->last_recency;
+    }
+
+    rank->last_recency = 0;
+    if (stat(path, &st) == 0) {
+        age_days = st.st_mtime < rank->now ? (rank->now - st.st_mtime) / 86400.0 : 0;
+        rank->last_recency = RANK_RECENCY_BONUS / (1 + age_days);
+    }
+    snprintf(rank->last_path, sizeof(rank->last_path), "%s", path);
+    return rank->last_recency;
+}
+
+/*
+ * Score a "path:line:text" result. Higher is better.
+ */
+double rank_score(rank_t *rank, const char *line) {
+    char path[RANK_MAX_PATH];
+    double score = 0;
+
+    if (result_line_path(line, path, sizeof(path)) > 0) {
+        score += rank_path_score(rank, path);
+        score += recency_score(rank, path);
+    }
+    if (result_line_match_is_word(line, result_line_content_offset(line))) {
+        score += RANK_WORD_BONUS;
+    }
+    return score;
+}
+
+static int better(const rank_entry_t *a, const rank_entry_t *b) {
+    return a->score > b->score || (a->score == b->score && a->seq < b->seq);
+}
+
+static void sift_down(rank_t *rank, int i) {
+    rank_entry_t entry = rank->entries[i];
+    int child;
+
+    while ((child = 2 * i + 1) < rank->length) {
+        if (child + 1 < rank->length && better(&rank->entries[child], &rank->entries[child + 1])) {
+            child++;
+        }
+        if (!better(&entry, &rank->entries[child])) {
+            break;
+        }
+        rank->entries[i] = rank->entries[child];
+        i = child;
+    }
+    rank->entries[i] = entry;
+}
+
+static void sift_up(rank_t *rank, int i) {
+    rank_entry_t entry = rank->entries[i];
+
+    while (i > 0 && better(&rank->entries[(i - 1) / 2], &entry)) {
+        rank->entries[i] = rank->entries[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    rank->entries[i] = entry;
+}
+
+/*
+ * Score the first len bytes of line and keep a copy of it if it is among
+ * the best K seen so far, dropping the worst line kept if there is no room.
+ * Returns 1 if the line was kept, 0 otherwise.
+ */
+int rank_add(rank_t *rank, const char *line, size_t len) {
+    rank_entry_t entry;
+
+    if (len + 1 > rank->scratch_size) {
+        rank->scratch_size = (len + 1) * 2;
+        rank->scratch = realloc(rank->scratch, rank->scratch_size);
+        if (rank->scratch == NULL) {
+            printf("ERROR: rank_add: failed to allocate");
+            exit(1);
+        }
+    }
+    memcpy(rank->scratch, line, len);
+    rank->scratch[len] = '\0';
+    entry.score = rank_score(rank, rank->scratch);
+    entry.seq = rank->seq++;
+
+    // most results lose against the worst line kept and are never copied
+    if (rank->length == rank->capacity && !better(&entry, &rank->entries[0])) {
+        return 0;
+    }
+    entry.line = malloc(len + 1);
+    if (entry.line == NULL) {
+        printf("ERROR: rank_add: failed to allocate");
+        exit(1);
+    }
+    memcpy(entry.line, rank->scratch, len + 1);
+
+    if (rank->length < rank->capacity) {
+        rank->entries[rank->length++] = entry;
+        sift_up(rank, rank->length - 1);
+        return 1;
+    }
+    free(rank->entries[0].line);
+    rank->entries[0] = entry;
+    sift_down(rank, 0);
+    return 1;
+}
+
+static int compare_worst_first(const void *a, const void *b) {
+    if (better(b, a)) {
+        return -1;
+    }
+    return better(a, b) ? 1 : 0;
+}
+
+/*
+ * Replace the contents of lines with copies of the lines kept, worst
+ * first, so the best result ends up last, next to the input field.
+ */
+void rank_sorted(rank_t *rank, line_list_t *lines) {
+    int i;
+
+    memcpy(rank->sorted, rank->entries, sizeof(rank_entry_t) * rank->length);
+    qsort(rank->sorted, rank->length, sizeof(rank_entry_t), compare_worst_first);
+
+    line_list_clear(lines);
+    for (i = 0; i < rank->length; i++) {
+        line_list_add(lines, strlen(rank->sorted[i].line), rank->sorted[i].line);
+    }
+}
+
+/*
+ * Drop every line kept, ready for a new search.
+ */
+void rank_clear(rank_t *rank) {
+    int i;
+
+    for (i = 0; i < rank->length; i++) {
+        free(rank->entries[i].line);
+    }
+    rank->length = 0;
+    rank->seq = 0;
+    rank->now = time(NULL);
+    rank->last_path[0] = '\0';
+}
+
+void rank_deallocate(rank_t **rank) {
+    if (rank == NULL || *rank == NULL) {
+        return;
+    }
+    rank_clear(*rank);
+    free((*rank)->entries);
+    free((*rank)->sorted);
+    free((*rank)->scratch);
+    free(*rank);
+    *rank = NULL;
+}
@@ -0,0 +1,47 @@
+#ifndef RANK_H
+#define RANK_H
+
+#include <stddef.h>
+#include <time.h>
+#include "line_list.h"
+
+#define RANK_MAX_PATH 4096
+
+/*
+ * Streaming top-K ranking of result lines. Each line is scored once when
+ * it arrives and only the best K are kept, in a min-heap whose root is the
+ * worst line kept, so memory stays O(K) however many results arrive.
+ */
+
+typedef struct {
+    double score;
+    unsigned long seq;      // arrival order, earlier results win ties
+    char *line;
+} rank_entry_t;
+
+typedef struct {
+    int capacity;
+    int length;
+    rank_entry_t *entries;  // heap ordered, worst entry first
+    rank_entry_t *sorted;   // scratch for rank_sorted
+    char *scratch;          // line being scored
+    size_t scratch_size;
+    unsigned long seq;
+    time_t now;
+    char cwd[RANK_MAX_PATH];
+    size_t cwd_length;
+
+    // results of one file arrive together, so one stat per file is enough
+    char last_path[RANK_MAX_PATH];
+    double last_recency;
+} rank_t;
+
+rank_t* rank_init(int capacity);
+double rank_path_score(rank_t *rank, const char *path);
+double rank_score(rank_t *rank, const char *line);
+int rank_add(rank_t *rank, const char *line, size_t len);
+void rank_sorted(rank_t *rank, line_list_t *lines);
+void rank_clear(rank_t *rank);
+void rank_deallocate(rank_t **rank);
+
+#endif
@@ -0,0 +1,676 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include "result_cache.h"
+#include "result_line.h"
+
+/*
+ * On-disk layout (native byte order, it is a per-machine cache):
+ *   "RTGC" u32 version
+ *   u32 key length, key bytes
+ *   u32 file count, per file of the listing, sorted by path: u32 path
+ *       length, path, i64 mtime sec, i64 mtime nsec, i64 size
+ *   u32 line count, per line: i32 file index, u32 length, bytes
+ */
+#define CACHE_MAGIC "RTGC"
+#define CACHE_VERSION 2
+#define MAX_PATH_LEN 4096
+#define UNLISTED_FILE -2
+
+static uint64_t hash_bytes(uint64_t h, const char *s, size_t n) {
+    size_t i;
+
+    // FNV-1a
+    for (i = 0; i < n; i++) {
+        h ^= (unsigned char)s[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+static uint64_t hash_string(const char *s) {
+    return hash_bytes(14695981039346656037ULL, s, strlen(s));
+}
+
+static int compare_files(const void *a, const void *b) {
+    return strcmp(((const cache_file_t *)a)->path, ((const cache_file_t *)b)->path);
+}
+
+/*
+ * Index of path in a listing, or RESULT_CACHE_NO_FILE.
+ */
+static int find_file(const cache_listing_t *listing, const char *path) {
+    int low = 0, high = listing->file_count - 1, middle, order;
+
+    while (low <= high) {
+        middle = low + (high - low) / 2;
+        order = strcmp(listing->files[middle].path, path);
+        if (order == 0) {
+            return middle;
+        }
+        if (order < 0) {
+            low = middle + 1;
+        } else {
+            high = middle - 1;
+        }
+    }
+    return RESULT_CACHE_NO_FILE;
+}
+
+static void add_file(cache_listing_t *listing, const char *path, const struct stat *st) {
+    cache_file_t *file;
+
+    if (listing->file_count == listing->capacity) {
+        listing->capacity = listing->capacity ? listing->capacity * 2 : 256;
+        listing->files = realloc(listing->files, sizeof(cache_file_t) * listing->capacity);
+        if (listing->files == NULL) {
+            printf("ERROR: result_cache_list: failed to allocate");
+            exit(1);
+        }
+    }
+    file = &listing->files[listing->file_count++];
+    file->path = strdup(path);
+    file->mtime_sec = (long long)st->st_mtim.tv_sec;
+    file->mtime_nsec = st->st_mtim.tv_nsec;
+    file->size = (long long)st->st_size;
+}
+
+static int refresh_stopped(cache_refresh_t *refresh) {
+    int stop;
+
+    if (refresh == NULL) {
+        return 0;
+    }
+    pthread_mutex_lock(&refresh->lock);
+    stop = refresh->stop;
+    pthread_mutex_unlock(&refresh->lock);
+    return stop;
+}
+
+/*
+ * Add every regular file under path to listing. Like grep -r, symbolic
+ * links found while walking are not followed. Version control metadata
+ * changes with every commit and is left out. Returns -1 once refresh is
+ * stopped.
+ */
+static int list_dir(const char *path, cache_listing_t *listing, cache_refresh_t *refresh) {
+    static const char *skipped[] = {".git", ".hg", ".svn", NULL};
+    char child[MAX_PATH_LEN];
+    struct dirent *entry;
+    struct stat st;
+    DIR *dir;
+    int i, result = 0;
+
+    if (refresh_stopped(refresh)) {
+        return -1;
+    }
+    dir = opendir(path);
+    if (dir == NULL) {
+        return 0;
+    }
+
+    while (result == 0 && (entry = readdir(dir)) != NULL) {
+        for (i = 0; skipped[i] && strcmp(entry->d_name, skipped[i]) != 0; i++) {
+        }
+        if (skipped[i] || strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) {
+            continue;
+        }
+        if (snprintf(child, sizeof(child), "%s/%s", path, entry->d_name) >= (int)sizeof(child)) {
+            continue;
+        }
+        if (fstatat(dirfd(dir), entry->d_name, &st, AT_SYMLINK_NOFOLLOW) != 0) {
+            continue;
+        }
+        if (S_ISDIR(st.st_mode)) {
+            result = list_dir(child, listing, refresh);
+        } else if (S_ISREG(st.st_mode)) {
+            add_file(listing, child, &st);
+        }
+    }
+
+    closedir(dir);
+    return result;
+}
+
+/*
+ * List the tree under root, or return NULL once refresh is stopped.
+ */
+static cache_listing_t* list_tree(const char *root, cache_refresh_t *refresh) {
+    cache_listing_t *listing = calloc(1, sizeof(cache_listing_t));
+
+    if (listing == NULL) {
+        printf("ERROR: result_cache_list: failed to allocate");
+        exit(1);
+    }
+    if (list_dir(root, listing, refresh) != 0) {
+        result_cache_listing_deallocate(&listing);
+        return NULL;
+    }
+    qsort(listing->files, listing->file_count, sizeof(cache_file_t), compare_files);
+    return listing;
+}
+
+static int write_u32(FILE *f, uint32_t v) {
+    return fwrite(&v, sizeof(v), 1, f) == 1 ? 0 : -1;
+}
+
+static int write_i64(FILE *f, int64_t v) {
+    return fwrite(&v, sizeof(v), 1, f) == 1 ? 0 : -1;
+}
+
+static int write_bytes(FILE *f, const char *s, uint32_t n) {
+    if (write_u32(f, n) != 0) {
+        return -1;
+    }
+    return (n == 0 || fwrite(s, 1, n, f) == n) ? 0 : -1;
+}
+
+static int read_u32(FILE *f, uint32_t *v) {
+    return fread(v, sizeof(*v), 1, f) == 1 ? 0 : -1;
+}
+
+static int read_i64(FILE *f, int64_t *v) {
+    return fread(v, sizeof(*v), 1, f) == 1 ? 0 : -1;
+}
+
+/*
+ * Read a length prefixed string into a freshly allocated, NUL terminated
+ * buffer. Returns NULL on short reads or implausible lengths.
+ */
+static char* read_bytes(FILE *f, uint32_t *n) {
+    char *s;
+
+    if (read_u32(f, n) != 0 || *n > (1u << 30)) {
+        return NULL;
+    }
+    s = malloc(*n + 1);
+    if (s == NULL) {
+        return NULL;
+    }
+    if (*n > 0 && fread(s, 1, *n, f) != *n) {
+        free(s);
+        return NULL;
+    }
+    s[*n] = '\0';
+    return s;
+}
+
+static int make_dirs(char *path) {
+    char *p;
+
+    for (p = path + 1; *p; p++) {
+        if (*p == '/') {
+            *p = '\0';
+            if (mkdir(path, 0700) != 0 && errno != EEXIST) {
+                *p = '/';
+                return -1;
+            }
+            *p = '/';
+        }
+    }
+    if (mkdir(path, 0700) != 0 && errno != EEXIST) {
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * Returns the cache directory ($XDG_CACHE_HOME/rtgrep, falling back to
+ * ~/.cache/rtgrep), creating it if needed. Returns NULL if no usable
+ * directory exists. Caller frees the result.
+ */
+char* result_cache_dir() {
+    const char *base = getenv("XDG_CACHE_HOME");
+    const char *home = getenv("HOME");
+    char *dir;
+    size_t n;
+
+    if (base && base[0] == '/') {
+        n = strlen(base) + sizeof("/rtgrep");
+        dir = malloc(n);
+        snprintf(dir, n, "%s/rtgrep", base);
+    } else if (home && home[0] == '/') {
+        n = strlen(home) + sizeof("/.cache/rtgrep");
+        dir = malloc(n);
+        snprintf(dir, n, "%s/.cache/rtgrep", home);
+    } else {
+        return NULL;
+    }
+
+    if (make_dirs(dir) != 0) {
+        free(dir);
+        return NULL;
+    }
+    return dir;
+}
+
+/*
+ * Build the cache key for a search. The three parts are joined with a
+ * separator that cannot appear in a C string. Caller frees the result.
+ */
+char* result_cache_key(const char *root, const char *command, const char *pattern) {
+    size_t n = strlen(root) + strlen(command) + strlen(pattern) + 3;
+    char *key = malloc(n);
+
+    snprintf(key, n, "%s\n%s\n%s", root, command, pattern);
+    return key;
+}
+
+/*
+ * Returns the file that holds the entry for key. The full key is stored
+ * inside the entry too, so hash collisions read as misses.
+ */
+char* result_cache_entry_path(const char *dir, const char *key) {
+    size_t n = strlen(dir) + 32;
+    char *path = malloc(n);
+
+    snprintf(path, n, "%s/%016llx.cache", dir, (unsigned long long)hash_string(key));
+    return path;
+}
+
+/*
+ * Index in listing of the file a result line came from, RESULT_CACHE_NO_FILE
+ * if the line has no path or the path is not a regular file (a message like
+ * "grep: ..."), or UNLISTED_FILE for a file created after the listing was
+ * taken. Relative paths are looked up below "./", where the listing is taken.
+ */
+static int line_file(const cache_listing_t *listing, const char *line) {
+    char path[MAX_PATH_LEN];
+    struct stat st;
+    int index;
+
+    memcpy(path, "./", 2);
+    if (result_line_path(line, path + 2, sizeof(path) - 2) < 0) {
+        return RESULT_CACHE_NO_FILE;
+    }
+    if (path[2] == '/' || strncmp(path + 2, "./", 2) == 0) {
+        index = find_file(listing, path + 2);
+    } else {
+        index = find_file(listing, path);
+    }
+    if (index == RESULT_CACHE_NO_FILE && stat(path + 2, &st) == 0 && S_ISREG(st.st_mode)) {
+        return UNLISTED_FILE;
+    }
+    return index;
+}
+
+/*
+ * Write lines to the cache along with the listing of the tree taken when
+ * the search started. Lines of files missing from the listing were created
+ * since, so they are left out and their files searched as new ones next
+ * time; lines without a path are kept. The entry is written to a temporary
+ * file and renamed into place so concurrent readers never see a partial
+ * entry. Returns 0 on success, -1 on failure.
+ */
+int result_cache_store(const char *entry_path, const char *key, line_list_t *lines, const cache_listing_t *listing) {
+    char *tmp_path;
+    uint32_t stored = 0;
+    size_t n;
+    FILE *f;
+    int *line_files;
+    int i, failed = 0;
+
+    line_files = malloc(sizeof(int) * (lines->length + 1));
+    for (i = 0; i < lines->length; i++) {
+        line_files[i] = line_file(listing, lines->lines[i]);
+        if (line_files[i] != UNLISTED_FILE) {
+            stored++;
+        }
+    }
+
+    n = strlen(entry_path) + 32;
+    tmp_path = malloc(n);
+    snprintf(tmp_path, n, "%s.tmp.%ld", entry_path, (long)getpid());
+
+    f = fopen(tmp_path, "wb");
+    if (f == NULL) {
+        failed = 1;
+    } else {
+        failed |= fwrite(CACHE_MAGIC, 1, 4, f) != 4;
+        failed |= write_u32(f, CACHE_VERSION);
+        failed |= write_bytes(f, key, strlen(key));
+        failed |= write_u32(f, listing->file_count);
+        for (i = 0; i < listing->file_count && !failed; i++) {
+            failed |= write_bytes(f, listing->files[i].path, strlen(listing->files[i].path));
+            failed |= write_i64(f, listing->files[i].mtime_sec);
+            failed |= write_i64(f, listing->files[i].mtime_nsec);
+            failed |= write_i64(f, listing->files[i].size);
+        }
+        failed |= write_u32(f, stored);
+        for (i = 0; i < lines->length && !failed; i++) {
+            if (line_files[i] != UNLISTED_FILE) {
+                failed |= write_u32(f, (uint32_t)line_files[i]);
+                failed |= write_bytes(f, lines->lines[i], strlen(lines->lines[i]));
+            }
+        }
+        failed |= fclose(f) != 0;
+
+        if (failed || rename(tmp_path, entry_path) != 0) {
+            unlink(tmp_path);
+            failed = 1;
+        }
+    }
+
+    free(line_files);
+    free(tmp_path);
+
+    return failed ? -1 : 0;
+}
+
+/*
+ * Load the entry for key. Returns NULL on a miss, a key mismatch or a
+ * corrupt entry.
+ */
+cache_entry_t* result_cache_load(const char *entry_path, const char *key) {
+    cache_entry_t *entry;
+    char magic[4];
+    char *s;
+    uint32_t version, n, count, file_index;
+    int64_t v;
+    int i, ok = 0;
+    FILE *f;
+
+    f = fopen(entry_path, "rb");
+    if (f == NULL) {
+        return NULL;
+    }
+
+    entry = calloc(1, sizeof(cache_entry_t));
+    entry->lines = line_list_init();
+
+    if (fread(magic, 1, 4, f) != 4 || memcmp(magic, CACHE_MAGIC, 4) != 0
+        || read_u32(f, &version) != 0 || version != CACHE_VERSION) {
+        goto done;
+    }
+
+    s = read_bytes(f, &n);
+    if (s == NULL || strcmp(s, key) != 0) {
+        free(s);
+        goto done;
+    }
+    free(s);
+
+    if (read_u32(f, &count) != 0 || count > (1u << 24)) {
+        goto done;
+    }
+    entry->listing.files = calloc(count + 1, sizeof(cache_file_t));
+    entry->listing.capacity = count + 1;
+    for (i = 0; i < (int)count; i++) {
+        cache_file_t *file = &entry->listing.files[i];
+
+        if ((file->path = read_bytes(f, &n)) == NULL) {
+            goto done;
+        }
+        entry->listing.file_count++;
+        // comparing listings relies on the order
+        if (i > 0 && strcmp(file[-1].path, file->path) >= 0) {
+            goto done;
+        }
+        if (read_i64(f, &v) != 0) goto done;
+        file->mtime_sec = v;
+        if (read_i64(f, &v) != 0) goto done;
+        file->mtime_nsec = (long)v;
+        if (read_i64(f, &v) != 0) goto done;
+        file->size = v;
+    }
+
+    if (read_u32(f, &count) != 0 || count > (1u << 28)) {
+        goto done;
+    }
+    entry->line_files = malloc(sizeof(int) * (count + 1));
+    for (i = 0; i < (int)count; i++) {
+        if (read_u32(f, &file_index) != 0 || (s = read_bytes(f, &n)) == NULL) {
+            goto done;
+        }
+        if ((int)file_index >= entry->listing.file_count) {
+            file_index = (uint32_t)RESULT_CACHE_NO_FILE;
+        }
+        entry->line_files[i] = (int)file_index;
+        line_list_add(entry->lines, n, s);
+        free(s);
+    }
+    ok = 1;
+
+done:
+    fclose(f);
+    if (!ok) {
+        result_cache_deallocate(&entry);
+    }
+    return entry;
+}
+
+/*
+ * Compare the listing stored in an entry with the current one. Lines of
+ * files that are unchanged, and lines without a file, are added to kept;
+ * files that are new or whose mtime or size changed are added to targets.
+ * Lines of deleted files are dropped.
+ */
+void result_cache_compare(const cache_entry_t *entry, const cache_listing_t *current,
+                          line_list_t *kept, line_list_t *targets) {
+    const cache_listing_t *previous = &entry->listing;
+    char *stale = calloc(previous->file_count + 1, 1);
+    int i = 0, j = 0, order, f;
+
+    // both listings are sorted by path, so one pass pairs them up
+    while (i < previous->file_count || j < current->file_count) {
+        if (i == previous->file_count) {
+            order = 1;
+        } else if (j == current->file_count) {
+            order = -1;
+        } else {
+            order = strcmp(previous->files[i].path, current->files[j].path);
+        }
+
+        if (order < 0) {
+            stale[i++] = 1;
+        } else if (order > 0) {
+            line_list_add(targets, strlen(current->files[j].path), current->files[j].path);
+            j++;
+        } else {
+            if (previous->files[i].mtime_sec != current->files[j].mtime_sec
+                || previous->files[i].mtime_nsec != current->files[j].mtime_nsec
+                || previous->files[i].size != current->files[j].size) {
+                stale[i] = 1;
+                line_list_add(targets, strlen(current->files[j].path), current->files[j].path);
+            }
+            i++;
+            j++;
+        }
+    }
+
+    for (i = 0; i < entry->lines->length; i++) {
+        f = entry->line_files[i];
+        if (f == RESULT_CACHE_NO_FILE || !stale[f]) {
+            line_list_add(kept, strlen(entry->lines->lines[i]), entry->lines->lines[i]);
+        }
+    }
+
+    free(stale);
+}
+
+/*
+ * List every regular file under root, sorted by path.
+ */
+cache_listing_t* result_cache_list(const char *root) {
+    return list_tree(root, NULL);
+}
+
+void result_cache_listing_deallocate(cache_listing_t **listing) {
+    int i;
+
+    if (listing == NULL || *listing == NULL) {
+        return;
+    }
+    for (i = 0; i < (*listing)->file_count; i++) {
+        free((*listing)->files[i].path);
+    }
+    free((*listing)->files);
+    free(*listing);
+    *listing = NULL;
+}
+
+void result_cache_deallocate(cache_entry_t **entry) {
+    int i;
+
+    if (entry == NULL || *entry == NULL) {
+        return;
+    }
+    for (i = 0; i < (*entry)->listing.file_count; i++) {
+        free((*entry)->listing.files[i].path);
+    }
+    free((*entry)->listing.files);
+    free((*entry)->line_files);
+    line_list_deallocate(&(*entry)->lines);
+    free(*entry);
+    *entry = NULL;
+}
+
+static void free_refresh(cache_refresh_t *refresh) {
+    free(refresh->root);
+    result_cache_deallocate(&refresh->previous);
+    result_cache_listing_deallocate(&refresh->listing);
+    if (refresh->kept) {
+        line_list_deallocate(&refresh->kept);
+        line_list_deallocate(&refresh->targets);
+    }
+    free(refresh->entry_path);
+    free(refresh->key);
+    if (refresh->lines) {
+        line_list_deallocate(&refresh->lines);
+    }
+    pthread_mutex_destroy(&refresh->lock);
+    pthread_cond_destroy(&refresh->cond);
+    free(refresh);
+}
+
+static void* refresh_main(void *arg) {
+    cache_refresh_t *refresh = arg;
+    cache_listing_t *listing;
+    line_list_t *kept = NULL, *targets = NULL;
+    int released;
+
+    listing = list_tree(refresh->root, refresh);
+    if (listing && refresh->previous) {
+        kept = line_list_init();
+        targets = line_list_init();
+        result_cache_compare(refresh->previous, listing, kept, targets);
+    }
+
+    pthread_mutex_lock(&refresh->lock);
+    refresh->listing = listing;
+    refresh->kept = kept;
+    refresh->targets = targets;
+    refresh->listed = 1;
+    while (!refresh->stop && refresh->lines == NULL) {
+        pthread_cond_wait(&refresh->cond, &refresh->lock);
+    }
+    pthread_mutex_unlock(&refresh->lock);
+
+    // once handed over, the entry to write is no longer touched by the owner
+    if (refresh->lines && listing) {
+        result_cache_store(refresh->entry_path, refresh->key, refresh->lines, listing);
+    }
+
+    pthread_mutex_lock(&refresh->lock);
+    refresh->finished = 1;
+    released = refresh->released;
+    pthread_mutex_unlock(&refresh->lock);
+    if (released) {
+        free_refresh(refresh);
+    }
+    return NULL;
+}
+
+/*
+ * Start listing the tree under root for a search. previous is the entry
+ * whose lines are shown while the search runs, or NULL on a cache miss;
+ * the refresh takes it over.
+ */
+cache_refresh_t* result_cache_refresh_start(const char *root, cache_entry_t *previous) {
+    cache_refresh_t *refresh = calloc(1, sizeof(cache_refresh_t));
+
+    if (refresh == NULL) {
+        printf("ERROR: result_cache_refresh_start: failed to allocate");
+        exit(1);
+    }
+    refresh->root = strdup(root);
+    refresh->previous = previous;
+    pthread_mutex_init(&refresh->lock, NULL);
+    pthread_cond_init(&refresh->cond, NULL);
+    pthread_create(&refresh->thread, NULL, refresh_main, refresh);
+
+    return refresh;
+}
+
+/*
+ * Returns 1 once the listing, and on a cache hit the kept lines and the
+ * target files, are ready to be read, 0 otherwise. Never blocks on the
+ * listing.
+ */
+int result_cache_refresh_poll(cache_refresh_t *refresh) {
+    int listed;
+
+    pthread_mutex_lock(&refresh->lock);
+    listed = refresh->listed;
+    pthread_mutex_unlock(&refresh->lock);
+    return listed;
+}
+
+/*
+ * Hand over the complete results of the search, which are written to the
+ * cache with the listing once it is ready. lines is copied.
+ */
+void result_cache_refresh_store(cache_refresh_t *refresh, const char *entry_path, const char *key, line_list_t *lines) {
+    line_list_t *copy = line_list_init();
+    int i;
+
+    for (i = 0; i < lines->length; i++) {
+        line_list_add(copy, strlen(lines->lines[i]), lines->lines[i]);
+    }
+
+    pthread_mutex_lock(&refresh->lock);
+    refresh->entry_path = strdup(entry_path);
+    refresh->key = strdup(key);
+    refresh->lines = copy;
+    pthread_cond_signal(&refresh->cond);
+    pthread_mutex_unlock(&refresh->lock);
+}
+
+/*
+ * Let go of a refresh. The listing is abandoned unless results were handed
+ * over, in which case they are still written. With wait set this returns
+ * once the thread is done, otherwise the thread finishes on its own.
+ */
+void result_cache_refresh_release(cache_refresh_t **refresh, int wait) {
+    pthread_t thread;
+    int finished;
+
+    if (refresh == NULL || *refresh == NULL) {
+        return;
+    }
+
+    pthread_mutex_lock(&(*refresh)->lock);
+    if ((*refresh)->lines == NULL) {
+        (*refresh)->stop = 1;
+    }
+    pthread_cond_signal(&(*refresh)->cond);
+    thread = (*refresh)->thread;
+    finished = (*refresh)->finished;
+    (*refresh)->released = !finished && !wait;
+    pthread_mutex_unlock(&(*refresh)->lock);
+
+    if (finished || wait) {
+        pthread_join(thread, NULL);
+        free_refresh(*refresh);
+    } else {
+        pthread_detach(thread);
+    }
+    *refresh = NULL;
+}
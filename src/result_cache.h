@@ -0,0 +1,72 @@
+#ifndef RESULT_CACHE_H
+#define RESULT_CACHE_H
+
+#include <pthread.h>
+#include "line_list.h"
+
+#define RESULT_CACHE_NO_FILE -1
+
+typedef struct {
+    char *path;
+    long long mtime_sec;
+    long mtime_nsec;
+    long long size;
+} cache_file_t;
+
+typedef struct {
+    int file_count;
+    cache_file_t *files;    // every regular file under the root, sorted by path
+    int capacity;
+} cache_listing_t;
+
+typedef struct {
+    cache_listing_t listing;    // the tree when the search started
+    line_list_t *lines;
+    int *line_files;    // index into listing.files for each line, or RESULT_CACHE_NO_FILE
+} cache_entry_t;
+
+/*
+ * Background work for a search with the cache enabled. A thread lists the
+ * tree; on a cache hit it compares the listing with the one stored in the
+ * entry to find the cached lines that are still valid and the files that
+ * must be searched again. Once the search is complete the same thread
+ * writes the entry, so the UI never waits for a stat of every file.
+ */
+typedef struct {
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int stop;           // the search was replaced before it completed
+    int listed;         // the fields below are complete
+    int finished;
+    int released;       // the owner is gone, the thread frees the refresh
+
+    char *root;
+    cache_entry_t *previous;    // entry shown while refreshing, NULL on a miss
+    cache_listing_t *listing;
+    line_list_t *kept;          // lines of previous from unchanged files
+    line_list_t *targets;       // new and changed files
+
+    // entry to write once the search is complete
+    char *entry_path;
+    char *key;
+    line_list_t *lines;
+} cache_refresh_t;
+
+char* result_cache_dir();
+char* result_cache_entry_path(const char *dir, const char *key);
+char* result_cache_key(const char *root, const char *command, const char *pattern);
+cache_listing_t* result_cache_list(const char *root);
+void result_cache_compare(const cache_entry_t *entry, const cache_listing_t *current,
+                          line_list_t *kept, line_list_t *targets);
+int result_cache_store(const char *entry_path, const char *key, line_list_t *lines, const cache_listing_t *listing);
+cache_entry_t* result_cache_load(const char *entry_path, const char *key);
+void result_cache_listing_deallocate(cache_listing_t **listing);
+void result_cache_deallocate(cache_entry_t **entry);
+
+cache_refresh_t* result_cache_refresh_start(const char *root, cache_entry_t *previous);
+int result_cache_refresh_poll(cache_refresh_t *refresh);
+void result_cache_refresh_store(cache_refresh_t *refresh, const char *entry_path, const char *key, line_list_t *lines);
+void result_cache_refresh_release(cache_refresh_t **refresh, int wait);
+
+#endif
@@ -0,0 +1,331 @@
+#include <stdio.h>
+#include <string.h>
+#include "result_line.h"
+
+/*
+ * Returns the number of bytes taken by the escape sequence starting at s,
+ * or 0 if s does not start an escape sequence.
+ */
+static size_t escape_length(const char *s) {
+    size_t i;
+
+    if (s[0] != '\033') {
+        return 0;
+    }
+    if (s[1] != '[') {
+        return s[1] ? 2 : 1;
+    }
+
+    // CSI: parameters and intermediates, terminated by a final byte in @..~
+    for (i = 2; s[i]; i++) {
+        if (s[i] >= '@' && s[i] <= '~') {
+            return i + 1;
+        }
+    }
+    return i;
+}
+
+/*
+ * Copy line into out with all ANSI escape sequences removed.
+ * out is always NUL terminated and the result is truncated to fit.
+ * Returns the length of the stripped string.
+ */
+size_t result_line_strip_ansi(const char *line, char *out, size_t out_size) {
+    size_t len = 0;
+    size_t skip;
+
+    if (out_size == 0) {
+        return 0;
+    }
+
+    while (*line && len < out_size - 1) {
+        if ((skip = escape_length(line)) > 0) {
+            line += skip;
+            continue;
+        }
+        out[len++] = *line++;
+    }
+    out[len] = '\0';
+    return len;
+}
+
+/*
+ * Extract the file path from a result line, i.e. everything before the
+ * first ':' once color escapes are removed.
+ * Returns the path length, or -1 if the line has no path prefix or the
+ * path does not fit in path_size.
+ */
+int result_line_path(const char *line, char *path, size_t path_size) {
+    size_t len = 0;
+    size_t skip;
+
+    while (*line) {
+        if ((skip = escape_length(line)) > 0) {
+            line += skip;
+            continue;
+        }
+        if (*line == ':') {
+            if (len == 0 || len >= path_size) {
+                return -1;
+            }
+            path[len] = '\0';
+            return (int)len;
+        }
+        if (len < path_size) {
+            path[len] = *line;
+        }
+        len++;
+        line++;
+    }
+
+    return -1;
+}
+
+/*
+ * Skip the "path:" prefix and up to two numeric "line:" / "column:" fields
+ * of a line that has already been stripped of color escapes.
+ * Returns the line itself if it has no path prefix.
+ */
+const char* result_line_content(const char *stripped) {
+    const char *content = strchr(stripped, ':');
+    const char *p;
+    int field;
+
+    if (content == NULL) {
+        return stripped;
+    }
+    content++;
+
+    for (field = 0; field < 2; field++) {
+        for (p = content; *p >= '0' && *p <= '9'; p++);
+        if (p == content || *p != ':') {
+            break;
+        }
+        content = p + 1;
+    }
+    return content;
+}
+
+/*
+ * Returns the line number of a "path:line:text" result, or -1 if the field
+ * after the path is not a number.
+ */
+long result_line_number(const char *line) {
+    long number = 0;
+    int digits = 0;
+    size_t skip;
+
+    // skip the path
+    while (*line) {
+        if ((skip = escape_length(line)) > 0) {
+            line += skip;
+            continue;
+        }
+        if (*line++ == ':') {
+            break;
+        }
+    }
+
+    while (*line) {
+        if ((skip = escape_length(line)) > 0) {
+            line += skip;
+            continue;
+        }
+        if (*line == ':') {
+            return digits > 0 ? number : -1;
+        }
+        if (*line < '0' || *line > '9' || digits >= 18) {
+            return -1;
+        }
+        number = number * 10 + (*line - '0');
+        digits++;
+        line++;
+    }
+    return -1;
+}
+
+/*
+ * Print at most width columns of line, passing color escapes through.
+ * Other escapes (grep's erase to end of line) are dropped so printing
+ * never touches the screen beyond the printed columns. Tabs and control
+ * characters are printed as a single space so every byte maps to a known
+ * column, UTF-8 continuation bytes take no column.
+ * Returns the number of columns printed.
+ */
+int result_line_print(FILE *out, const char *line, int width) {
+    return result_line_print_span(out, line, (size_t)-1, width);
+}
+
+/*
+ * Like result_line_print, but stops after len bytes of line. Only the
+ * bytes that are printed are looked at, so the cost depends on width and
+ * not on the length of the line.
+ */
+int result_line_print_span(FILE *out, const char *line, size_t len, int width) {
+    const unsigned char *p = (const unsigned char *)line;
+    int columns = 0;
+    size_t i = 0;
+    size_t skip;
+
+    while (i < len && p[i]) {
+        if ((skip = escape_length((const char *)p + i)) > 0) {
+            if (p[i + skip - 1] == 'm') {
+                fwrite(p + i, 1, skip, out);
+            }
+            i += skip;
+            continue;
+        }
+        if ((p[i] & 0xC0) == 0x80) {
+            fputc(p[i++], out);
+            continue;
+        }
+        if (columns == width) {
+            break;
+        }
+        fputc(p[i] < 0x20 ? ' ' : p[i], out);
+        i++;
+        columns++;
+    }
+    return columns;
+}
+
+/*
+ * Byte offset of the text after the "path:" prefix and up to two numeric
+ * fields of a line that may still contain color escapes, or 0 if the line
+ * has no path prefix. Escapes following the last ':' belong to the text.
+ */
+size_t result_line_content_offset(const char *line) {
+    const char *p = strchr(line, ':');
+    const char *content;
+    int field, digits;
+    size_t skip;
+
+    if (p == NULL) {
+        return 0;
+    }
+    content = p + 1;
+
+    for (field = 0; field < 2; field++) {
+        digits = 0;
+        for (p = content; *p; p++) {
+            if ((skip = escape_length(p)) > 0) {
+                p += skip - 1;
+            } else if (*p >= '0' && *p <= '9') {
+                digits++;
+            } else {
+                break;
+            }
+        }
+        if (digits == 0 || *p != ':') {
+            break;
+        }
+        content = p + 1;
+    }
+    return content - line;
+}
+
+/*
+ * Number of bytes among the first len bytes of line that are not part of
+ * a color escape, i.e. the offset in the stripped line that byte offset
+ * len of line maps to.
+ */
+size_t result_line_visible_length(const char *line, size_t len) {
+    size_t visible = 0, i = 0, skip;
+
+    while (i < len && line[i]) {
+        if ((skip = escape_length(line + i)) > 0) {
+            i += skip;
+            continue;
+        }
+        visible++;
+        i++;
+    }
+    return visible;
+}
+
+/*
+ * Byte offset of the first highlighted match at or after from, i.e. of the
+ * first color escape that sets a color rather than resetting it.
+ * Returns -1 if nothing is highlighted.
+ */
+long result_line_match_offset(const char *line, size_t from) {
+    const char *p = line + from;
+    size_t len, i;
+
+    while ((p = strchr(p, '\033')) != NULL) {
+        len = escape_length(p);
+        if (len > 3 && p[1] == '[' && p[len - 1] == 'm') {
+            for (i = 2; i < len - 1 && (p[i] == '0' || p[i] == ';'); i++);
+            if (i < len - 1) {
+                return p - line;
+            }
+        }
+        p += len;
+    }
+    return -1;
+}
+
+/*
+ * Move offset forward past any escape sequence or UTF-8 character it falls
+ * inside of, so printing can start there. Escapes are short, so only a few
+ * bytes before offset (and none before from) are looked at.
+ */
+size_t result_line_align(const char *line, size_t from, size_t offset) {
+    size_t start = offset > from + 32 ? offset - 32 : from;
+    size_t i, len;
+
+    for (i = offset; i > start; i--) {
+        if (line[i - 1] == '\033') {
+            len = escape_length(line + i - 1);
+            if (i - 1 + len > offset) {
+                offset = i - 1 + len;
+            }
+            break;
+        }
+    }
+    while (((unsigned char)line[offset] & 0xC0) == 0x80) {
+        offset++;
+    }
+    return offset;
+}
+
+static int is_word_char(int c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+}
+
+/*
+ * Returns 1 if the first highlighted match at or after from is a whole
+ * word, i.e. neither the character before it nor the one after it is a
+ * letter, digit or underscore. Returns 0 if it is part of a longer word or
+ * nothing is highlighted.
+ */
+int result_line_match_is_word(const char *line, size_t from) {
+    const char *p = line + from;
+    int before = 0, after = 0;
+    int state = 0;      // 0 before the match, 1 inside it, 2 after it
+    size_t len, i;
+
+    while (*p && state < 3) {
+        if ((len = escape_length(p)) > 0) {
+            if (len > 2 && p[1] == '[' && p[len - 1] == 'm') {
+                for (i = 2; i < len - 1 && (p[i] == '0' || p[i] == ';'); i++);
+                if (i < len - 1 && state == 0) {
+                    state = 1;
+                } else if (i == len - 1 && state == 1) {
+                    state = 2;
+                }
+            }
+            p += len;
+            continue;
+        }
+        if (state == 0) {
+            before = (unsigned char)*p;
+        } else if (state == 2) {
+            after = (unsigned char)*p;
+            state = 3;
+        }
+        p++;
+    }
+
+    return state >= 2 && !is_word_char(before) && !is_word_char(after);
+}
@@ -0,0 +1,24 @@
+#ifndef RESULT_LINE_H
+#define RESULT_LINE_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+/*
+ * Helpers for picking apart a single line of backend output
+ * ("path:line:text", possibly wrapped in ANSI color escapes).
+ */
+
+size_t result_line_strip_ansi(const char *line, char *out, size_t out_size);
+int result_line_path(const char *line, char *path, size_t path_size);
+const char* result_line_content(const char *stripped);
+long result_line_number(const char *line);
+int result_line_print(FILE *out, const char *line, int width);
+int result_line_print_span(FILE *out, const char *line, size_t len, int width);
+size_t result_line_content_offset(const char *line);
+size_t result_line_visible_length(const char *line, size_t len);
+long result_line_match_offset(const char *line, size_t from);
+size_t result_line_align(const char *line, size_t from, size_t offset);
+int result_line_match_is_word(const char *line, size_t from);
+
+#endif
@@ -3,7 +3,10 @@
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
 #include <sys/wait.h>
+#include <poll.h>
 #include <ncurses.h>
 #include <signal.h>
 #include <time.h>
@@ -11,11 +14,38 @@
 #include "ansi.h"
 #include "line_list.h"
 #include "arguments.h"
+#include "command.h"
+#include "result_cache.h"
+#include "query.h"
+#include "search.h"
+#include "result_line.h"
+#include "preview.h"
+#include "rank.h"
+#include "fuzzy.h"
+#include "governor.h"
+#include "stream.h"
 
 #define MAX_PATTERN_LEN 256
 #define MAX_OUTPUT_LINES 1000
-#define MAX_LINE_LEN 512
+#define READ_BUFFER_SIZE 65536
 #define TYPING_DELAY_MS 100
+#define FRAME_INTERVAL_MS 16
+#define MAX_STATUS_LEN 64
+#define KEY_CTRL_F 6
+#define MAX_EXITING_BACKENDS 4
+#define BUILTIN_BACKEND_NAME "rtgrep-builtin"
+#define MAX_CACHE_TARGETS_LENGTH (64 * 1024)    // changed files passed on a grep command line
+
+typedef struct {
+    preview_t *preview;
+    line_list_t *lines;         // context lines of the latest response
+    char path[PREVIEW_MAX_PATH];
+    long first_line;
+    long line;
+    char requested_path[PREVIEW_MAX_PATH];
+    long requested_line;
+    int needs_redraw;
+} preview_pane_t;
 
 typedef struct {
     int input_height;
@@ -24,13 +54,47 @@ typedef struct {
     char last_pattern[MAX_PATTERN_LEN];
     int separator_drawn;
     int input_needs_refresh;
+    preview_pane_t *preview;    // NULL unless the preview pane is enabled
+    int browsing;               // keys navigate the results instead of editing the pattern
+    int filtering;              // keys edit the filter instead of the pattern
+    int count;                  // count typed before a navigation key in browse mode
+    char last_status[MAX_STATUS_LEN];
 } ui_context_t;
 
+typedef struct {
+    size_t content;     // offset of the text after the "path:line:" prefix
+    size_t match;       // offset of the first highlighted match, or content
+    size_t length;
+} result_span_t;
+
 typedef struct {
     line_list_t *line_list;
-    int display_start;
+    line_list_t *candidates;    // unfiltered backend output, multi-term mode only
+    query_t *query;             // query applied to candidates, multi-term mode only
+    int display_start;          // index of the result on the top row
     int last_displayed_count;
+    int last_display_start;
     int needs_full_redraw;
+    int rows_dirty;             // visible rows changed without the selection moving
+    int selected;               // index of the selected result, -1 until the user moves it
+    int following;              // the selection stays on the newest result as more arrive
+    int last_selected;
+    struct timeval last_draw_time;
+    unsigned char *marks;       // marked results, indexed like line_list
+    int marks_capacity;
+    int mark_count;
+    int print_selected;         // on exit print the selection instead of every result
+    result_span_t *spans;       // layout of the results, indexed like line_list
+    int span_count;
+    int span_capacity;
+    int hscroll;                // columns the text of every row is scrolled by
+    rank_t *ranking;            // best results, NULL unless results are ranked
+    int ranking_dirty;          // line_list no longer shows the best results
+    int ranking_unsent;         // the ranked results shown were not sent to the event stream
+    fuzzy_t *fuzzy;             // second stage filter, NULL until it is first used
+    line_list_t *unfiltered;    // every result while a filter is applied, NULL otherwise
+    char filter[MAX_PATTERN_LEN];   // fuzzy sub-query applied to the results
+    int filter_dirty;           // line_list no longer shows the filtered results
 } output_buffer_t;
 
 typedef struct {
@@ -38,23 +102,79 @@ typedef struct {
     int pipe_read_fd;
     struct timeval last_keypress_time;
     int timer_active;
+    char *cache_dir;    // NULL unless the result cache is enabled
+    char *cache_key;    // key of the search feeding the output buffer
+    cache_refresh_t *cache_refresh; // listing of the tree for the search, NULL without the cache
+    line_list_t *waiting_patterns;  // patterns of a backend waiting for the listing, NULL otherwise
+    char *backend_key;  // pattern(s) the backend was last started with
+    int multi_term;
+    int builtin;        // search in-process instead of running grep_command
+    int backend_options;    // COMMAND_ flags of grep_command, 0 for the builtin backend
+    char *pending;      // start of a line whose end has not been read yet
+    size_t pending_length;
+    size_t pending_capacity;
+    pid_t exiting[MAX_EXITING_BACKENDS];    // stopped backends not reaped yet, oldest first
+    int exiting_count;
 } grep_state_t;
 
 // globals for saving stdout so we can use it after we finish
 static FILE *tty_file = NULL;
 static int original_stdout = -1;
 static char grep_command[512] = "grep -rn --color=always";
+static governor_t governor;
+static stream_t *event_stream = NULL;  // NULL unless results are streamed to an editor
 
 void init_ui(ui_context_t *ui);
 void cleanup_ui(output_buffer_t *output_buffer);
 void draw_ui(ui_context_t *ui, const char *pattern, output_buffer_t *output);
 void execute_grep(const char *pattern, output_buffer_t *output, grep_state_t *grep_state);
-void grep_process(int pipefd[2], const char pattern[], const char *command);
-int handle_input(char *pattern, grep_state_t *grep_state);
+void start_backend(grep_state_t *grep_state, line_list_t *patterns, line_list_t *targets);
+void grep_process(int pipefd[2], const char *full_command);
+void builtin_process(int pipefd[2], line_list_t *terms, line_list_t *targets);
+int handle_input(ui_context_t *ui, char *pattern, grep_state_t *grep_state, output_buffer_t *output);
+int handle_browse_key(ui_context_t *ui, int ch, output_buffer_t *output);
+void move_selection(output_buffer_t *output, int delta);
+void select_result(output_buffer_t *output, int index);
+void follow_newest(output_buffer_t *output);
+int selected_result(output_buffer_t *output);
+int update_display_start(output_buffer_t *output, int display_lines);
+void toggle_mark(output_buffer_t *output, int index);
+int is_marked(output_buffer_t *output, int index);
+void clear_marks(output_buffer_t *output);
+void print_results(output_buffer_t *output);
+void print_result(const char *line);
+int output_pane_width(ui_context_t *ui);
+void draw_result_row(int row, const char *line, const result_span_t *span, int hscroll, int selected, int marked, int width);
+void draw_status(ui_context_t *ui, output_buffer_t *output);
+void draw_preview(ui_context_t *ui, int display_lines, int column);
+void update_preview(ui_context_t *ui, output_buffer_t *output);
+long elapsed_ms(const struct timeval *since);
 void kill_current_grep(grep_state_t *grep_state);
+void stop_backend(grep_state_t *grep_state, pid_t pid);
+void reap_backends(grep_state_t *grep_state);
+void wait_for_events(grep_state_t *grep_state);
 int should_execute_grep(const char *pattern, grep_state_t *grep_state);
+int search_complete(grep_state_t *grep_state);
 void update_keypress_time(grep_state_t *grep_state);
-void handle_grep_results_if_any(int *pipefd, output_buffer_t *output);
+int handle_grep_results_if_any(grep_state_t *grep_state, output_buffer_t *output);
+void add_pending(grep_state_t *grep_state, const char *data, size_t len);
+int load_cached_results(const char *backend_key, output_buffer_t *output, grep_state_t *grep_state);
+void revalidate_cached_results(grep_state_t *grep_state, output_buffer_t *output);
+void store_cached_results(grep_state_t *grep_state, output_buffer_t *output);
+void add_result(output_buffer_t *output, int s, char line[]);
+void clear_results(output_buffer_t *output);
+void replace_results(output_buffer_t *output, line_list_t *lines);
+void index_results(output_buffer_t *output);
+void scroll_horizontally(output_buffer_t *output, int delta);
+void clamp_hscroll(output_buffer_t *output, int start, int display_lines, int width);
+void filter_results(output_buffer_t *output);
+void show_ranked_results(output_buffer_t *output);
+void stream_ranked_results(output_buffer_t *output, int complete);
+void stream_search_done(output_buffer_t *output);
+void apply_filter(output_buffer_t *output);
+void show_filtered_results(output_buffer_t *output);
+line_list_t* all_results(output_buffer_t *output);
+char* backend_patterns_for(const char *pattern, output_buffer_t *output, grep_state_t *grep_state, line_list_t *patterns);
 
 /**
  * Main function - initializes the application and runs the main event loop
@@ -66,10 +186,14 @@ int main(int argc, char *argv[]) {
     output_buffer_t output = {0};
     char pattern[MAX_PATTERN_LEN] = "";
     grep_state_t grep_state = {0};
+    preview_pane_t preview_pane = {0};
     arguments_t *args;
+    int input;
 
     //init line list
     output.line_list = line_list_init();
+    output.selected = -1;
+    output.last_selected = -1;
     
     // Parse command line arguments
     args = get_cli_arguments(argc, argv);
@@ -79,6 +203,35 @@ int main(int argc, char *argv[]) {
         strcpy(grep_command, args->grep_command);
     }
 
+    if (args->use_cache) {
+        grep_state.cache_dir = result_cache_dir();
+    }
+
+    grep_state.builtin = args->builtin;
+    grep_state.backend_options = args->builtin ? 0 : command_options(grep_command);
+    governor_init(&governor, args->nice, args->max_workers, args->cgroup);
+
+    if (args->stream_path) {
+        // opening a FIFO waits for the editor, before the screen is taken over
+        event_stream = stream_open(args->stream_path);
+        if (event_stream == NULL) {
+            fprintf(stderr, "Cannot open %s: %s\n", args->stream_path, strerror(errno));
+            deallocate_arguments(&args);
+            exit(1);
+        }
+        // a reader going away shows up as a write error instead
+        signal(SIGPIPE, SIG_IGN);
+    }
+
+    if (args->multi_term) {
+        grep_state.multi_term = 1;
+        output.candidates = line_list_init();
+    }
+
+    if (args->top_k > 0) {
+        output.ranking = rank_init(args->top_k);
+    }
+
     if (args->pattern) {
         strcpy(pattern, args->pattern);
         gettimeofday(&grep_state.last_keypress_time, NULL);
@@ -86,28 +239,89 @@ int main(int argc, char *argv[]) {
     }
     
     init_ui(&ui);
+
+    if (args->preview_context > 0) {
+        preview_pane.preview = preview_init(args->preview_context);
+        preview_pane.lines = line_list_init();
+        ui.preview = &preview_pane;
+    }
     
     while (1) {
+        wait_for_events(&grep_state);
+        reap_backends(&grep_state);
+
         if (should_execute_grep(pattern, &grep_state)) {
             execute_grep(pattern, &output, &grep_state);
         }
         
+        if (grep_state.waiting_patterns && result_cache_refresh_poll(grep_state.cache_refresh)) {
+            revalidate_cached_results(&grep_state, &output);
+        }
+
         if (grep_state.pipe_read_fd > 0) {
-            handle_grep_results_if_any(&grep_state.pipe_read_fd, &output);
+            if (handle_grep_results_if_any(&grep_state, &output) == 1) {
+                store_cached_results(&grep_state, &output);
+                stream_search_done(&output);
+            }
         }
         
-        if (handle_input(pattern, &grep_state) == -1) {
+        // take every key typed since the last frame before drawing
+        while ((input = handle_input(&ui, pattern, &grep_state, &output)) == 1) {
+        }
+        if (input == -1) {
             break;
         }
-        
+
+        update_preview(&ui, &output);
         draw_ui(&ui, pattern, &output);
+        if (output.ranking_unsent) {
+            stream_ranked_results(&output, search_complete(&grep_state));
+        }
+
+        if (stream_flush(event_stream) != 0) {
+            stream_close(&event_stream);
+        }
     }
     
+    // a completed search is still written to the cache
+    result_cache_refresh_release(&grep_state.cache_refresh, 1);
     kill_current_grep(&grep_state);
+
+    // exit with the final ranking and filter, unless what is printed refers
+    // to the order on screen
+    if (!(output.print_selected && ((output.selected >= 0 && !output.following) || output.mark_count > 0))) {
+        if (output.ranking && output.ranking_dirty) {
+            show_ranked_results(&output);
+        }
+        if (output.filter_dirty) {
+            show_filtered_results(&output);
+        }
+    }
     cleanup_ui(&output);
-  
+    stream_close(&event_stream);
+
+    if (preview_pane.preview) {
+        preview_deallocate(&preview_pane.preview);
+        line_list_deallocate(&preview_pane.lines);
+    }
+
+    free(output.marks);
+    free(output.spans);
+    free(grep_state.pending);
+    free(grep_state.cache_dir);
+    free(grep_state.cache_key);
+    free(grep_state.backend_key);
+    query_deallocate(&output.query);
+    rank_deallocate(&output.ranking);
+    fuzzy_deallocate(&output.fuzzy);
+    if (output.unfiltered) {
+        line_list_deallocate(&output.unfiltered);
+    }
     deallocate_arguments(&args);
     line_list_deallocate(&(output.line_list));
+    if (output.candidates) {
+        line_list_deallocate(&(output.candidates));
+    }
     return 0;
 }
 
@@ -143,6 +357,11 @@ void init_ui(ui_context_t *ui) {
     ui->last_pattern[1] = '?'; // Ensure it won't match empty pattern initially
     ui->separator_drawn = 0;
     ui->input_needs_refresh = 1;
+    ui->preview = NULL;
+    ui->browsing = 0;
+    ui->filtering = 0;
+    ui->count = 0;
+    ui->last_status[0] = '\0';
 }
 
 /**
@@ -158,56 +377,121 @@ void cleanup_ui(output_buffer_t *output_buffer) {
     close(original_stdout);
     
     //print the output buffer to the original stdout 
-    for (i = 0; i < output_buffer->line_list->length; i++)
-    {
-        printf("%s\n", output_buffer->line_list->lines[i]);
+    stream_final(event_stream);
+    if (output_buffer->print_selected) {
+        print_results(output_buffer);
+    } else {
+        for (i = 0; i < output_buffer->line_list->length; i++)
+        {
+            print_result(output_buffer->line_list->lines[i]);
+        }
     }
+    stream_done(event_stream);
 
     if (tty_file){
         fclose(tty_file);
     }
 }
 
+/**
+ * Prints the results chosen on exit: the marked results, or the selected
+ * result if none are marked, or every result if nothing was selected
+ */
+void print_results(output_buffer_t *output) {
+    int selected = selected_result(output);
+    int i;
+
+    if (output->mark_count > 0) {
+        for (i = 0; i < output->line_list->length; i++) {
+            if (is_marked(output, i)) {
+                print_result(output->line_list->lines[i]);
+            }
+        }
+    } else if (output->selected >= 0 && selected >= 0) {
+        print_result(output->line_list->lines[selected]);
+    } else {
+        for (i = 0; i < output->line_list->length; i++) {
+            print_result(output->line_list->lines[i]);
+        }
+    }
+}
+
+/**
+ * Prints a result on exit, and sends it in the final generation of the
+ * event stream
+ */
+void print_result(const char *line) {
+    printf("%s\n", line);
+    stream_result(event_stream, line, strlen(line));
+}
+
 /**
  * Draws the complete UI including both panes with current data
  * Displays grep results in the output pane and the current pattern in the input pane
- * Handles display of results that exceed the output pane size by showing most recent lines
+ * Shows the most recent results until a result is selected, then keeps the
+ * selection in view. Only the visible rows are drawn, however many results
+ * there are, and results that arrive while the view is unchanged are drawn
+ * at most once per frame
  */
 void draw_ui(ui_context_t *ui, const char *pattern, output_buffer_t *output) {
     int display_lines = ui->height - ui->input_height - 1;
-    int start_line = (output->line_list->length > display_lines) ? output->line_list->length - display_lines : 0;
-    
+    int pane_width = output_pane_width(ui);
+    int length = output->line_list->length;
+    int start_line = update_display_start(output, display_lines);
+    int selected = selected_result(output);
+    int rows_changed = 0;
+
+    // re-sorting moves results around, so the order is frozen while the
+    // user is looking at a selected or marked result
+    if (output->ranking_dirty && (output->selected < 0 || output->following) && output->mark_count == 0
+        && elapsed_ms(&output->last_draw_time) >= FRAME_INTERVAL_MS) {
+        show_ranked_results(output);
+        length = output->line_list->length;
+        start_line = update_display_start(output, display_lines);
+        selected = selected_result(output);
+    }
+    if (output->filter_dirty && (output->selected < 0 || output->following) && output->mark_count == 0
+        && elapsed_ms(&output->last_draw_time) >= FRAME_INTERVAL_MS) {
+        show_filtered_results(output);
+        length = output->line_list->length;
+        start_line = update_display_start(output, display_lines);
+        selected = selected_result(output);
+    }
+    index_results(output);
+
     if (output->needs_full_redraw) {
         printf(ANSI_CLEAR_SCREEN);
-        
-        for (int i = 0; i < output->line_list->length && i < display_lines; i++) {
-            int line_idx = start_line + i;
-            printf(ANSI_GOTO_POS "%s\n", i + 1, 1, output->line_list->lines[line_idx]);
-        }
-        
         output->needs_full_redraw = 0;
-        output->last_displayed_count = output->line_list->length;
+        rows_changed = 1;
         ui->separator_drawn = 0;
         ui->input_needs_refresh = 1;
-    } else if (output->line_list->length > output->last_displayed_count) {
-        int lines_to_add = output->line_list->length - output->last_displayed_count;
-        
-        if (lines_to_add >= display_lines) {
-            printf(ANSI_GOTO_POS, 1, 1);
-            for (int i = 0; i < display_lines; i++) {
-                int line_idx = start_line + i;
-                printf(ANSI_CLEAR_LINE "%s\n", output->line_list->lines[line_idx]);
-            }
-        } else {
-            for (int i = output->last_displayed_count; i < output->line_list->length; i++) {
-                if (i - start_line >= 0 && i - start_line < display_lines) {
-                    int display_row = (i - start_line) + 1;
-                    printf(ANSI_GOTO_POS "%s\n", display_row, 1, output->line_list->lines[i]);
-                }
-            }
+        if (ui->preview) {
+            ui->preview->needs_redraw = 1;
         }
-        
-        output->last_displayed_count = output->line_list->length;
+    } else if (output->selected != output->last_selected || start_line != output->last_display_start
+               || output->rows_dirty) {
+        rows_changed = 1;
+    } else if (length != output->last_displayed_count && elapsed_ms(&output->last_draw_time) >= FRAME_INTERVAL_MS) {
+        rows_changed = 1;
+    }
+
+    if (rows_changed) {
+        clamp_hscroll(output, start_line, display_lines, pane_width);
+        for (int i = 0; i < display_lines; i++) {
+            int line_idx = start_line + i;
+            draw_result_row(i + 1, line_idx < length ? output->line_list->lines[line_idx] : NULL,
+                            line_idx < length ? &output->spans[line_idx] : NULL, output->hscroll,
+                            line_idx == selected, is_marked(output, line_idx), pane_width);
+        }
+        output->last_displayed_count = length;
+        output->last_display_start = start_line;
+        output->last_selected = output->selected;
+        output->rows_dirty = 0;
+        gettimeofday(&output->last_draw_time, NULL);
+    }
+
+    if (ui->preview && ui->preview->needs_redraw) {
+        draw_preview(ui, display_lines, pane_width + 2);
     }
     
     if (!ui->separator_drawn) {
@@ -217,6 +501,10 @@ void draw_ui(ui_context_t *ui, const char *pattern, output_buffer_t *output) {
             printf(ANSI_HORIZONTAL_LINE);
         }
         ui->separator_drawn = 1;
+        ui->last_status[0] = '\0';
+    }
+    if (rows_changed || ui->last_status[0] == '\0') {
+        draw_status(ui, output);
     }
     
     if (strcmp(ui->last_pattern, pattern) != 0 || ui->input_needs_refresh) {
@@ -231,6 +519,10 @@ void draw_ui(ui_context_t *ui, const char *pattern, output_buffer_t *output) {
         printf("| > %s", pattern);
         // Fill remaining space 
         int used_chars = 4 + strlen(pattern); // "| > " + pattern
+        if (ui->filtering || output->filter[0] != '\0') {
+            printf("  ~ %s", output->filter);
+            used_chars += 4 + strlen(output->filter);
+        }
         for (int i = used_chars; i < ui->width - 1; i++) {
             printf(" ");
         }
@@ -240,117 +532,925 @@ void draw_ui(ui_context_t *ui, const char *pattern, output_buffer_t *output) {
     fflush(stdout);
 }
 
+/**
+ * Returns the width of the output pane, which shares the screen with the
+ * preview pane when that is enabled
+ */
+int output_pane_width(ui_context_t *ui) {
+    return ui->preview ? ui->width - ui->width / 2 - 1 : ui->width;
+}
+
+/**
+ * Draws one row of the output pane, clipped to width columns and padded so
+ * it overwrites whatever was drawn there before. A NULL line clears the row
+ * The gutter shows the selection and whether the result is marked
+ * Text that does not fit is shown through a window placed around the first
+ * match and shifted by hscroll, so only about width bytes are ever printed
+ */
+void draw_result_row(int row, const char *line, const result_span_t *span, int hscroll, int selected, int marked, int width) {
+    size_t start = span ? span->content : 0;
+    long shifted;
+    int used = 0;
+    int text_width;
+
+    printf(ANSI_GOTO_POS, row, 1);
+    if (line && width > 2) {
+        printf("%s%c", selected ? ANSI_REVERSE ">" ANSI_RESET : " ", marked ? '*' : ' ');
+        used = 2 + result_line_print_span(stdout, line, span->content, width - 2);
+        text_width = width - used;
+
+        if (span->length - span->content > (size_t)text_width || hscroll != 0) {
+            // keep a third of the window before the match for context
+            shifted = (long)span->match - text_width / 3 + hscroll;
+            if (shifted > (long)span->length - text_width) {
+                shifted = (long)span->length - text_width;
+            }
+            start = shifted > (long)span->content ? (size_t)shifted : span->content;
+            start = result_line_align(line, span->content, start);
+        }
+        used += result_line_print(stdout, line + start, text_width);
+        printf(ANSI_RESET);
+    }
+    for (; used < width; used++) {
+        putchar(' ');
+    }
+}
+
+/**
+ * Draws the position of the selection, the number of marked results and the
+ * input mode at the right end of the separator, when they changed
+ */
+void draw_status(ui_context_t *ui, output_buffer_t *output) {
+    char status[MAX_STATUS_LEN];
+    int len, i;
+
+    len = snprintf(status, sizeof(status), " %s%d/%d ", ui->browsing ? "BROWSE " : ui->filtering ? "FILTER " : "",
+                   selected_result(output) + 1, output->line_list->length);
+    if (output->mark_count > 0 && len < (int)sizeof(status)) {
+        len += snprintf(status + len, sizeof(status) - len, "%d marked ", output->mark_count);
+    }
+    if (len >= (int)sizeof(status)) {
+        len = sizeof(status) - 1;
+    }
+    if (strcmp(status, ui->last_status) == 0 || len + 2 > ui->width) {
+        return;
+    }
+
+    // restore the part of the separator a longer status covered
+    printf(ANSI_GOTO_POS, ui->height - 2, ui->width - (int)strlen(ui->last_status) - 1);
+    for (i = (int)strlen(ui->last_status); i > 0; i--) {
+        printf(ANSI_HORIZONTAL_LINE);
+    }
+    printf(ANSI_GOTO_POS "%s", ui->height - 2, ui->width - len - 1, status);
+    strcpy(ui->last_status, status);
+}
+
+/**
+ * Draws the preview pane starting at column: a separator, the previewed
+ * path as a header and the context lines around the selected line, which
+ * are scrolled so the selected line stays in view
+ */
+void draw_preview(ui_context_t *ui, int display_lines, int column) {
+    preview_pane_t *pane = ui->preview;
+    int width = ui->width - column + 1;
+    int visible = display_lines - 1;
+    int target = (int)(pane->line - pane->first_line);
+    int scroll = target - visible / 2;
+    char number[32];
+    int used;
+
+    if (scroll > pane->lines->length - visible) {
+        scroll = pane->lines->length - visible;
+    }
+    if (scroll < 0) {
+        scroll = 0;
+    }
+
+    for (int row = 0; row < display_lines; row++) {
+        int idx = scroll + row - 1;
+
+        printf(ANSI_GOTO_POS ANSI_VERTICAL_LINE, row + 1, column - 1);
+        used = 0;
+        if (row == 0 && pane->path[0] != '\0') {
+            printf(ANSI_BOLD);
+            used = result_line_print(stdout, pane->path, width);
+            printf(ANSI_RESET);
+        } else if (row > 0 && idx < pane->lines->length && width > 8) {
+            long lineno = pane->first_line + idx;
+
+            snprintf(number, sizeof(number), "%6ld%c", lineno, lineno == pane->line ? '>' : ' ');
+            printf("%s%s" ANSI_RESET, lineno == pane->line ? ANSI_REVERSE : "", number);
+            used = 7 + result_line_print(stdout, pane->lines->lines[idx], width - 7);
+        }
+        for (; used < width; used++) {
+            putchar(' ');
+        }
+    }
+    pane->needs_redraw = 0;
+}
+
+/**
+ * Asks the preview worker for the context of the selected result when the
+ * selection moved, and picks up its answer when one is ready. Neither step
+ * waits for the worker, so previewing never holds up typing or results
+ */
+void update_preview(ui_context_t *ui, output_buffer_t *output) {
+    preview_pane_t *pane = ui->preview;
+    char path[PREVIEW_MAX_PATH];
+    long line;
+    int selected;
+
+    if (pane == NULL) {
+        return;
+    }
+
+    selected = selected_result(output);
+    if (selected >= 0 && result_line_path(output->line_list->lines[selected], path, sizeof(path)) > 0
+        && (line = result_line_number(output->line_list->lines[selected])) > 0
+        && (line != pane->requested_line || strcmp(path, pane->requested_path) != 0)) {
+        strcpy(pane->requested_path, path);
+        pane->requested_line = line;
+        preview_request(pane->preview, path, line);
+    }
+
+    if (preview_poll(pane->preview, pane->path, sizeof(pane->path), pane->lines, &pane->first_line, &pane->line)) {
+        pane->needs_redraw = 1;
+    }
+
+    // nothing selected, so drop the preview and any answer still on its way
+    if (selected < 0 && pane->requested_path[0] != '\0') {
+        pane->requested_path[0] = '\0';
+        pane->requested_line = 0;
+    }
+    if (pane->requested_path[0] == '\0' && (pane->path[0] != '\0' || pane->lines->length > 0)) {
+        pane->path[0] = '\0';
+        line_list_clear(pane->lines);
+        pane->needs_redraw = 1;
+    }
+}
+
 /**
  * Executes grep command with the given pattern and captures output
  * Forks a grep process, sets up pipes for communication, and reads the results
  * Stores grep output in the output buffer, discarding excess results if needed
+ * When the result cache is enabled, cached results are shown immediately and
+ * the backend only searches the files that are new or changed since
+ * In multi-term mode a query that keeps the backend search unchanged only
+ * re-filters the results collected so far
  */
 void execute_grep(const char *pattern, output_buffer_t *output, grep_state_t *grep_state) {
+    line_list_t *patterns;
+    char *backend_key;
+
     if (strlen(pattern) == 0) {
         return;
     }
+
+    patterns = line_list_init();
+    backend_key = backend_patterns_for(pattern, output, grep_state, patterns);
+    if (backend_key == NULL) {
+        line_list_deallocate(&patterns);
+        return;
+    }
+    if (grep_state->multi_term && grep_state->backend_key
+        && strcmp(backend_key, grep_state->backend_key) == 0) {
+        stream_start(event_stream, pattern);
+        filter_results(output);
+        if (search_complete(grep_state)) {
+            stream_search_done(output);
+        }
+        free(backend_key);
+        line_list_deallocate(&patterns);
+        return;
+    }
     
     kill_current_grep(grep_state);
-    line_list_clear(output->line_list);
-    output->needs_full_redraw = 1;
-    
+    stream_start(event_stream, pattern);
+    clear_results(output);
+    free(grep_state->backend_key);
+    grep_state->backend_key = backend_key;
+
+    // on a cache hit the backend waits until the tree has been listed, to
+    // only search the files that changed
+    if (grep_state->cache_dir && load_cached_results(backend_key, output, grep_state)) {
+        grep_state->waiting_patterns = patterns;
+        return;
+    }
+
+    start_backend(grep_state, patterns, NULL);
+    line_list_deallocate(&patterns);
+}
+
+/**
+ * Forks the backend searching for patterns in targets, or in the whole
+ * tree when targets is NULL
+ */
+void start_backend(grep_state_t *grep_state, line_list_t *patterns, line_list_t *targets) {
+    char *full_command;
     int pipefd[2];
+
     if (pipe(pipefd) == -1) {
+        stream_done(event_stream);
         return;
     }
+
+    full_command = grep_state->builtin ? NULL : command_build_patterns(grep_command, patterns, targets);
     
     pid_t pid = fork();
     if (pid == -1) {
         // Fork failed 
         close(pipefd[0]);
         close(pipefd[1]);
+        stream_done(event_stream);
         printf("Failed to fork process!");
-        return;
-    }
-    
-    if (pid == 0) {
-        grep_process(pipefd, pattern, grep_command);
+    } else if (pid == 0) {
+        // a process group of its own lets the whole backend be stopped,
+        // including whatever the shell started
+        setpgid(0, 0);
+        signal(SIGPIPE, SIG_DFL);
+        governor_enter_backend(&governor);
+        if (grep_state->builtin) {
+            builtin_process(pipefd, patterns, targets);
+        }
+        grep_process(pipefd, full_command);
     } else {
         // This is the parent process
+        setpgid(pid, pid);
         grep_state->current_grep_pid = pid;
         grep_state->pipe_read_fd = pipefd[0];
+        fcntl(pipefd[0], F_SETFL, fcntl(pipefd[0], F_GETFL) | O_NONBLOCK);
         close(pipefd[1]);
     }
+
+    free(full_command);
 }
 
-void handle_grep_results_if_any(int *pipefd, output_buffer_t *output){
-    static char line[MAX_LINE_LEN];
-    static int line_pos = 0;
-    char ch;
-    ssize_t bytes_read;
+/**
+ * Works out what the backend has to search for. In multi-term mode the
+ * pattern is parsed into a query, which replaces the one applied to the
+ * output, and the backend only searches for one of its clauses. Terms are
+ * escaped unless the backend searches for fixed strings, and matched with
+ * the case handling of the backend command.
+ * Fills patterns and returns them joined into a single key, or NULL if there
+ * is nothing the backend could search for, leaving the query unchanged.
+ */
+char* backend_patterns_for(const char *pattern, output_buffer_t *output, grep_state_t *grep_state, line_list_t *patterns) {
+    query_case_t match_case = QUERY_MATCH_CASE;
+    query_t *query;
+    size_t len = 0;
+    char *key;
+    int i;
 
-    if ((bytes_read = read(*pipefd, &ch, 1)) > 0) {
-        if (ch == '\n') {
-            line[line_pos] = '\0';
-            line_list_add(output->line_list, MAX_LINE_LEN - 1, line);
-            line_pos = 0;
+    if (grep_state->multi_term) {
+        if (grep_state->backend_options & COMMAND_IGNORE_CASE) {
+            match_case = QUERY_IGNORE_CASE;
+        } else if (grep_state->backend_options & COMMAND_SMART_CASE) {
+            match_case = QUERY_SMART_CASE;
+        }
+        query = query_parse(pattern, match_case);
+        if (grep_state->builtin || (grep_state->backend_options & COMMAND_FIXED_STRINGS)) {
+            query_backend_terms(query, patterns);
+        } else {
+            query_backend_patterns(query, patterns);
+        }
+        if (patterns->length == 0) {
+            query_deallocate(&query);
+            return NULL;
+        }
+        query_deallocate(&output->query);
+        output->query = query;
+    } else {
+        line_list_add(patterns, strlen(pattern), (char *)pattern);
+    }
+
+    for (i = 0; i < patterns->length; i++) {
+        len += strlen(patterns->lines[i]) + 1;
+    }
+    key = malloc(len + 1);
+    key[0] = '\0';
+    for (i = 0; i < patterns->length; i++) {
+        if (i > 0) {
+            strcat(key, "\n");
+        }
+        strcat(key, patterns->lines[i]);
+    }
+    return key;
+}
+
+/**
+ * Adds a line of backend output to the output buffer
+ * In multi-term mode every line is kept as a candidate, but only lines
+ * matching the current query are displayed
+ * When results are ranked only the best are kept, and they are displayed
+ * and sent to the event stream once the next frame is drawn
+ */
+void add_result(output_buffer_t *output, int s, char line[]) {
+    if (output->candidates != NULL) {
+        line_list_add(output->candidates, s, line);
+        line = output->candidates->lines[output->candidates->length - 1];
+        if (output->query != NULL && !query_matches_line(output->query, line)) {
             return;
-        } else if (line_pos < MAX_LINE_LEN - 1) {
-            line[line_pos++] = ch;
         }
+    }
+    if (output->ranking == NULL) {
+        stream_result(event_stream, line, s);
+    }
+
+    if (output->ranking) {
+        if (rank_add(output->ranking, line, s)) {
+            output->ranking_dirty = 1;
+        }
+    } else if (output->candidates != NULL) {
+        // displayed lines point at the stored candidate instead of a copy
+        line_list_add_ref(all_results(output), line);
+    } else {
+        line_list_add(all_results(output), s, line);
+    }
+    if (output->unfiltered) {
+        output->filter_dirty = 1;
+    }
+}
+
+/**
+ * Drops every result, along with the selection, marks and scrolling that
+ * refer to them
+ */
+void clear_results(output_buffer_t *output) {
+    line_list_clear(output->line_list);
+    if (output->unfiltered) {
+        line_list_clear(output->unfiltered);
+        fuzzy_reset(output->fuzzy);
+    }
+    output->selected = -1;
+    output->following = 0;
+    output->span_count = 0;
+    output->hscroll = 0;
+    clear_marks(output);
+    if (output->ranking) {
+        rank_clear(output->ranking);
+        output->ranking_dirty = 0;
+    }
+    if (output->candidates) {
+        line_list_clear(output->candidates);
+    }
+    output->needs_full_redraw = 1;
+}
+
+/**
+ * Shows lines instead of the current results. The selection, marks and
+ * scrolling stay on the results that are still there, found by their text;
+ * a selected result that is gone leaves the selection where it was
+ */
+void replace_results(output_buffer_t *output, line_list_t *lines) {
+    line_list_t *marked = line_list_init();
+    char *selected = NULL;
+    int selected_index = output->selected;
+    int following = output->following;
+    int hscroll = output->hscroll;
+    int i, j;
+
+    if (selected_index >= 0 && !following && selected_index < output->line_list->length) {
+        selected = strdup(output->line_list->lines[selected_index]);
+    }
+    for (i = 0; i < output->line_list->length; i++) {
+        if (is_marked(output, i)) {
+            line_list_add(marked, strlen(output->line_list->lines[i]), output->line_list->lines[i]);
+        }
+    }
+
+    clear_results(output);
+    stream_restart(event_stream);
+    for (i = 0; i < lines->length; i++) {
+        add_result(output, strlen(lines->lines[i]), lines->lines[i]);
+    }
+    // positions only mean something in the order that is shown
+    if (output->ranking && output->ranking_dirty) {
+        show_ranked_results(output);
+    }
+    if (output->filter_dirty) {
+        show_filtered_results(output);
+    }
+
+    output->hscroll = hscroll;
+    if (following) {
+        follow_newest(output);
+    } else if (selected_index >= 0) {
+        select_result(output, selected_index);
+    }
+    for (i = 0; i < output->line_list->length; i++) {
+        if (selected && strcmp(output->line_list->lines[i], selected) == 0) {
+            select_result(output, i);
+            free(selected);
+            selected = NULL;
+        }
+        for (j = 0; j < marked->length; j++) {
+            if (strcmp(output->line_list->lines[i], marked->lines[j]) == 0) {
+                toggle_mark(output, i);
+                break;
+            }
+        }
+    }
+
+    free(selected);
+    line_list_deallocate(&marked);
+}
+
+/**
+ * Replaces the displayed results with the best ranked results, best last
+ * The filtered results point into the ranked results, so they are filtered
+ * again straight away
+ */
+void show_ranked_results(output_buffer_t *output) {
+    rank_sorted(output->ranking, all_results(output));
+    output->span_count = 0;
+    output->ranking_dirty = 0;
+    output->ranking_unsent = 1;
+    output->rows_dirty = 1;
+    if (output->unfiltered) {
+        fuzzy_reset(output->fuzzy);
+        show_filtered_results(output);
+    }
+}
+
+/**
+ * Sends the ranked results on screen as a new generation of the event
+ * stream, replacing the results sent before, so the editor shows the same
+ * results as the screen. The generation ends once the search is complete
+ */
+void stream_ranked_results(output_buffer_t *output, int complete) {
+    line_list_t *results = all_results(output);
+    int i;
+
+    output->ranking_unsent = 0;
+    stream_restart(event_stream);
+    for (i = 0; i < results->length; i++) {
+        stream_result(event_stream, results->lines[i], strlen(results->lines[i]));
+    }
+    if (complete) {
+        stream_done(event_stream);
+    }
+}
+
+/**
+ * Ends the generation of the event stream once the search is complete.
+ * Ranked results are sent with the frame that shows them, which ends it
+ * instead, so an outdated ranking is never sent as the final one
+ */
+void stream_search_done(output_buffer_t *output) {
+    if (output->ranking) {
+        if (!output->ranking_dirty) {
+            output->ranking_unsent = 1;
+        }
+    } else {
+        stream_done(event_stream);
+    }
+}
+
+/**
+ * Returns the list every result is added to: the displayed results, or
+ * the results the displayed ones are filtered from while a filter is applied
+ */
+line_list_t* all_results(output_buffer_t *output) {
+    return output->unfiltered ? output->unfiltered : output->line_list;
+}
+
+/**
+ * Applies the fuzzy filter after it was edited, or shows every result again
+ * once it is empty. The selection and marks refer to positions in the
+ * displayed results, so they are reset
+ */
+void apply_filter(output_buffer_t *output) {
+    output->selected = -1;
+    output->following = 0;
+    output->span_count = 0;
+    output->rows_dirty = 1;
+    clear_marks(output);
+
+    if (output->filter[0] == '\0') {
+        if (output->unfiltered) {
+            line_list_deallocate(&output->line_list);
+            output->line_list = output->unfiltered;
+            output->unfiltered = NULL;
+            output->filter_dirty = 0;
+        }
+        return;
+    }
+
+    if (output->fuzzy == NULL) {
+        output->fuzzy = fuzzy_init(governor_workers(&governor));
+    }
+    if (output->unfiltered == NULL) {
+        output->unfiltered = output->line_list;
+        output->line_list = line_list_init();
+        fuzzy_reset(output->fuzzy);
+    }
+    show_filtered_results(output);
+}
+
+/**
+ * Replaces the displayed results with the results matching the filter,
+ * best last. Only results added since the last call and, while the filter
+ * only grows, the results that matched it before are scored
+ */
+void show_filtered_results(output_buffer_t *output) {
+    fuzzy_update(output->fuzzy, output->unfiltered, output->filter);
+    fuzzy_results(output->fuzzy, output->unfiltered, output->line_list);
+    output->span_count = 0;
+    output->filter_dirty = 0;
+    output->rows_dirty = 1;
+}
+
+/**
+ * Rebuilds the displayed results by running the current query over the
+ * candidates collected so far, without searching the tree again
+ */
+void filter_results(output_buffer_t *output) {
+    int i;
+
+    if (output->candidates == NULL) {
+        return;
+    }
+
+    line_list_clear(output->line_list);
+    if (output->unfiltered) {
+        line_list_clear(output->unfiltered);
+        fuzzy_reset(output->fuzzy);
+        output->filter_dirty = 1;
+    }
+    output->selected = -1;
+    output->following = 0;
+    output->span_count = 0;
+    clear_marks(output);
+    if (output->ranking) {
+        rank_clear(output->ranking);
+        output->ranking_dirty = 1;
+    }
+    for (i = 0; i < output->candidates->length; i++) {
+        if (output->query == NULL || query_matches_line(output->query, output->candidates->lines[i])) {
+            if (output->ranking) {
+                rank_add(output->ranking, output->candidates->lines[i], strlen(output->candidates->lines[i]));
+            } else {
+                stream_result(event_stream, output->candidates->lines[i], strlen(output->candidates->lines[i]));
+                line_list_add_ref(all_results(output), output->candidates->lines[i]);
+            }
+        }
+    }
+    output->needs_full_redraw = 1;
+}
+
+/**
+ * Records where the text and the first match of every result added since
+ * the last call start. This looks at each result once, so drawing a row
+ * never has to scan its line
+ */
+void index_results(output_buffer_t *output) {
+    result_span_t *span;
+    const char *line;
+    long match;
+
+    if (output->line_list->length > output->span_capacity) {
+        output->span_capacity = output->line_list->capacity;
+        output->spans = realloc(output->spans, sizeof(result_span_t) * output->span_capacity);
+        if (output->spans == NULL) {
+            printf("ERROR: index_results: failed to allocate");
+            exit(1);
+        }
+    }
+
+    for (; output->span_count < output->line_list->length; output->span_count++) {
+        line = output->line_list->lines[output->span_count];
+        span = &output->spans[output->span_count];
+        span->content = result_line_content_offset(line);
+        match = result_line_match_offset(line, span->content);
+        span->match = match >= 0 ? (size_t)match : span->content;
+        span->length = span->content + strlen(line + span->content);
+    }
+}
+
+/**
+ * Looks up the cache entry for the backend search and shows its results
+ * straight away. Either way the tree is listed in the background: on a hit
+ * to find the cached results that are out of date and the files to search,
+ * and to store the results with once the search is complete. Returns 1 on
+ * a cache hit, 0 otherwise.
+ */
+int load_cached_results(const char *backend_key, output_buffer_t *output, grep_state_t *grep_state) {
+    char root[4096];
+    char *entry_path;
+    cache_entry_t *entry;
+    line_list_t *cached_lines;
+    int i;
+
+    free(grep_state->cache_key);
+    grep_state->cache_key = NULL;
+    if (getcwd(root, sizeof(root)) == NULL) {
+        return 0;
+    }
+    grep_state->cache_key = result_cache_key(root, grep_state->builtin ? BUILTIN_BACKEND_NAME : grep_command, backend_key);
+
+    entry_path = result_cache_entry_path(grep_state->cache_dir, grep_state->cache_key);
+    entry = result_cache_load(entry_path, grep_state->cache_key);
+    free(entry_path);
+    if (entry == NULL) {
+        grep_state->cache_refresh = result_cache_refresh_start(".", NULL);
+        return 0;
+    }
+
+    cached_lines = entry->lines;
+    if (output->ranking && output->candidates == NULL) {
+        // ranked results are only kept if they rank high enough
+        for (i = 0; i < cached_lines->length; i++) {
+            add_result(output, strlen(cached_lines->lines[i]), cached_lines->lines[i]);
+        }
+    } else {
+        for (i = 0; i < cached_lines->length; i++) {
+            line_list_add(output->candidates ? output->candidates : all_results(output),
+                          strlen(cached_lines->lines[i]), cached_lines->lines[i]);
+        }
+        output->filter_dirty = output->unfiltered != NULL;
+        // with multi-term queries filter_results sends the matching candidates
+        for (i = 0; output->candidates == NULL && i < all_results(output)->length; i++) {
+            stream_result(event_stream, all_results(output)->lines[i], strlen(all_results(output)->lines[i]));
+        }
+    }
+    filter_results(output);
+    grep_state->cache_refresh = result_cache_refresh_start(".", entry);
+
+    return 1;
+}
+
+/**
+ * Once the tree has been listed after a cache hit, drops the cached results
+ * of files that changed or were deleted and starts the backend on the files
+ * that are new or changed, if there are any. Their results are shown as
+ * they arrive. When the changed files would not fit on a command line the
+ * whole tree is searched instead, as on a cache miss
+ */
+void revalidate_cached_results(grep_state_t *grep_state, output_buffer_t *output) {
+    cache_refresh_t *refresh = grep_state->cache_refresh;
+    line_list_t *patterns = grep_state->waiting_patterns;
+    line_list_t *targets = refresh->targets;
+    line_list_t *none;
+    size_t length = 0;
+    int i;
+
+    grep_state->waiting_patterns = NULL;
+    for (i = 0; i < targets->length; i++) {
+        length += strlen(targets->lines[i]) + 3;
+    }
+
+    if (!grep_state->builtin && length > MAX_CACHE_TARGETS_LENGTH) {
+        none = line_list_init();
+        replace_results(output, none);
+        line_list_deallocate(&none);
+        start_backend(grep_state, patterns, NULL);
+    } else {
+        if (refresh->kept->length != refresh->previous->lines->length) {
+            replace_results(output, refresh->kept);
+        }
+        if (targets->length > 0) {
+            start_backend(grep_state, patterns, targets);
+        } else {
+            // nothing to search, the entry only needs updating if a file went away
+            if (refresh->kept->length != refresh->previous->lines->length
+                || refresh->listing->file_count != refresh->previous->listing.file_count) {
+                store_cached_results(grep_state, output);
+            }
+            stream_search_done(output);
+        }
+    }
+    line_list_deallocate(&patterns);
+}
+
+/**
+ * Hands the results of a search that has run to completion over to the
+ * cache, which writes them in the background
+ */
+void store_cached_results(grep_state_t *grep_state, output_buffer_t *output) {
+    char *entry_path;
+
+    if (grep_state->cache_refresh == NULL || grep_state->cache_key == NULL) {
+        return;
+    }
+    // ranking without multi-term queries keeps only the best results,
+    // which would make a cache entry that is missing the others
+    if (output->ranking && output->candidates == NULL) {
+        return;
+    }
+
+    entry_path = result_cache_entry_path(grep_state->cache_dir, grep_state->cache_key);
+    result_cache_refresh_store(grep_state->cache_refresh, entry_path, grep_state->cache_key,
+                               output->candidates ? output->candidates : all_results(output));
+    free(entry_path);
+}
+
+/**
+ * Reads pending grep output into the output buffer
+ * Reads whatever the backend has written (up to READ_BUFFER_SIZE bytes) without
+ * blocking. Complete lines are added straight from the read buffer; only the
+ * start of a line split across reads is held back, so lines of any length
+ * are kept whole
+ * Returns 1 when grep has closed its end of the pipe (the search is complete), 0 otherwise
+ */
+int handle_grep_results_if_any(grep_state_t *grep_state, output_buffer_t *output){
+    static char buffer[READ_BUFFER_SIZE];
+    char *start, *newline, *end;
+    ssize_t bytes_read;
+
+    bytes_read = read(grep_state->pipe_read_fd, buffer, sizeof(buffer));
+    if (bytes_read > 0) {
+        start = buffer;
+        end = buffer + bytes_read;
+        while ((newline = memchr(start, '\n', end - start)) != NULL) {
+            if (grep_state->pending_length > 0) {
+                add_pending(grep_state, start, newline - start);
+                add_result(output, grep_state->pending_length, grep_state->pending);
+                grep_state->pending_length = 0;
+            } else {
+                add_result(output, newline - start, start);
+            }
+            start = newline + 1;
+        }
+        add_pending(grep_state, start, end - start);
     } else if (bytes_read == 0) {
         // EOF - grep process finished
-        close(*pipefd);
-        *pipefd = 0;
-        line_pos = 0;
+        if (grep_state->pending_length > 0) {
+            add_result(output, grep_state->pending_length, grep_state->pending);
+            grep_state->pending_length = 0;
+        }
+        close(grep_state->pipe_read_fd);
+        grep_state->pipe_read_fd = 0;
+        return 1;
+    } else if (errno != EAGAIN && errno != EINTR) {
+        close(grep_state->pipe_read_fd);
+        grep_state->pipe_read_fd = 0;
+        grep_state->pending_length = 0;
     }
+    return 0;
+}
+
+/**
+ * Appends len bytes to the incomplete line held back between reads
+ */
+void add_pending(grep_state_t *grep_state, const char *data, size_t len) {
+    if (grep_state->pending_length + len > grep_state->pending_capacity) {
+        grep_state->pending_capacity = (grep_state->pending_length + len) * 2;
+        grep_state->pending = realloc(grep_state->pending, grep_state->pending_capacity);
+        if (grep_state->pending == NULL) {
+            printf("ERROR: add_pending: failed to allocate");
+            exit(1);
+        }
+    }
+    memcpy(grep_state->pending + grep_state->pending_length, data, len);
+    grep_state->pending_length += len;
 }
 
 /**
  * This function represents the child process that will run the grep command specified by the user
  */
-void grep_process(int pipefd[2], const char pattern[], const char *command){
+void grep_process(int pipefd[2], const char *full_command){
     close(pipefd[0]);
     dup2(pipefd[1], STDOUT_FILENO); // duplicate file descriptor of stdout and err 
     dup2(pipefd[1], STDERR_FILENO); // to the input side of the pipe
     close(pipefd[1]);
-    
-    // Build full command with pattern and current directory
-    char full_command[1024];
-    snprintf(full_command, sizeof(full_command), "%s \"%s\" .", command, pattern);
    
     execl("/bin/sh", "sh", "-c", full_command, NULL);
     exit(1);
 }
 
+/**
+ * Child process for the in-process backend. Searches targets, or the current
+ * directory when targets is NULL, for lines containing any of the literal
+ * terms, using memory-mapped files scanned by several worker threads
+ */
+void builtin_process(int pipefd[2], line_list_t *terms, line_list_t *targets) {
+    search_options_t options;
+    ac_automaton_t *ac;
+    line_list_t *roots;
+
+    close(pipefd[0]);
+    dup2(pipefd[1], STDOUT_FILENO);
+    dup2(pipefd[1], STDERR_FILENO);
+    close(pipefd[1]);
+
+    roots = targets;
+    if (roots == NULL) {
+        roots = line_list_init();
+        line_list_add(roots, 1, ".");
+    }
+
+    search_options_init(&options);
+    options.threads = governor_workers(&governor);
+    options.color = 1;
+    // a query of negated clauses only searches for the empty term
+    ac = terms->length == 1 && terms->lines[0][0] == '\0' ? NULL : ac_build(terms->lines, terms->length);
+    search_run(roots, ac, &options, stdout);
+    fflush(stdout);
+    _exit(0);
+}
+
 /**
  * Handles keyboard input from the user in the input field
  * Processes character input, backspace, Enter key, and ESC key
- * Returns -1 when user wants to exit (ESC), 0 otherwise
- * Triggers grep execution when Enter is pressed
+ * Up, Down, page, Home and End keys move the selected result, Left and
+ * Right scroll long lines, Tab switches to browse mode where printable keys
+ * navigate instead of editing the pattern, and Ctrl-F switches typing
+ * between the pattern and the fuzzy filter applied to its results
+ * Returns -1 when user wants to exit (Enter or ESC), 1 when a key was
+ * handled and 0 when no key was waiting
  */
-int handle_input(char *pattern, grep_state_t *grep_state) {
+int handle_input(ui_context_t *ui, char *pattern, grep_state_t *grep_state, output_buffer_t *output) {
     int ch = getch();
     int pattern_len = strlen(pattern);
+    int filter_len = strlen(output->filter);
     int pattern_changed = 0;
+    int page = ui->height - ui->input_height - 1;
     
     if (ch == ERR) {
         return 0;
     }
     
     switch (ch) {
-        case 27: // ESC key
         case KEY_ENTER:
         case '\n':
         case '\r':
+            output->print_selected = 1;
+            return -1;
+
+        case 27: // ESC key
             return -1;
+
+        case '\t':
+            ui->browsing = !ui->browsing;
+            ui->count = 0;
+            output->rows_dirty = 1;
+            break;
+
+        case KEY_CTRL_F:
+            ui->filtering = !ui->filtering;
+            ui->browsing = 0;
+            ui->input_needs_refresh = 1;
+            output->rows_dirty = 1;
+            break;
+
+        case KEY_UP:
+            move_selection(output, -1);
+            break;
+
+        case KEY_DOWN:
+            move_selection(output, 1);
+            break;
+
+        case KEY_PPAGE:
+            move_selection(output, -page);
+            break;
+
+        case KEY_NPAGE:
+            move_selection(output, page);
+            break;
+
+        case KEY_LEFT:
+            scroll_horizontally(output, -output_pane_width(ui) / 2);
+            break;
+
+        case KEY_RIGHT:
+            scroll_horizontally(output, output_pane_width(ui) / 2);
+            break;
+
+        case KEY_HOME:
+            select_result(output, 0);
+            break;
+
+        case KEY_END:
+            follow_newest(output);
+            break;
             
         case KEY_BACKSPACE:
         case 127:
         case '\b':
-            if (pattern_len > 0) {
+            if (ui->browsing) {
+                break;
+            } else if (ui->filtering && filter_len > 0) {
+                output->filter[filter_len - 1] = '\0';
+                ui->input_needs_refresh = 1;
+                apply_filter(output);
+            } else if (!ui->filtering && pattern_len > 0) {
                 pattern[pattern_len - 1] = '\0';
                 pattern_changed = 1;
             }
             break;
             
         default:
-            if (ch >= 32 && ch <= 126 && pattern_len < MAX_PATTERN_LEN - 1) {
+            if (ui->browsing) {
+                handle_browse_key(ui, ch, output);
+            } else if (ui->filtering) {
+                if (ch >= 32 && ch <= 126 && filter_len < MAX_PATTERN_LEN - 1) {
+                    output->filter[filter_len] = ch;
+                    output->filter[filter_len + 1] = '\0';
+                    ui->input_needs_refresh = 1;
+                    apply_filter(output);
+                }
+            } else if (ch >= 32 && ch <= 126 && pattern_len < MAX_PATTERN_LEN - 1) {
                 pattern[pattern_len] = ch;
                 pattern[pattern_len + 1] = '\0';
                 pattern_changed = 1;
@@ -359,23 +1459,325 @@ int handle_input(char *pattern, grep_state_t *grep_state) {
     }
     
     if (pattern_changed) {
-        kill_current_grep(grep_state);
+        // in multi-term mode the running search may still serve the new
+        // query, execute_grep decides whether it has to be replaced
+        if (!grep_state->multi_term) {
+            kill_current_grep(grep_state);
+        }
         update_keypress_time(grep_state);
     }
     
+    return 1;
+}
+
+/**
+ * Handles a printable key in browse mode, in the style of less and vi:
+ * j/k move, h/l scroll long lines, g/G go to the first/last result (or to result N when preceded
+ * by a count), N% goes N percent into the results and space marks the
+ * selected result for printing on exit
+ */
+int handle_browse_key(ui_context_t *ui, int ch, output_buffer_t *output) {
+    int count = ui->count;
+    int length = output->line_list->length;
+
+    ui->count = 0;
+    switch (ch) {
+        case 'j':
+            move_selection(output, count > 0 ? count : 1);
+            break;
+
+        case 'k':
+            move_selection(output, count > 0 ? -count : -1);
+            break;
+
+        case 'h':
+            scroll_horizontally(output, count > 0 ? -count : -8);
+            break;
+
+        case 'l':
+            scroll_horizontally(output, count > 0 ? count : 8);
+            break;
+
+        case 'g':
+        case 'G':
+            if (count > 0) {
+                select_result(output, count - 1);
+            } else if (ch == 'g') {
+                select_result(output, 0);
+            } else {
+                follow_newest(output);
+            }
+            break;
+
+        case '%':
+            if (count > 100) {
+                count = 100;
+            }
+            if (length > 0) {
+                select_result(output, (int)((long long)(length - 1) * count / 100));
+            }
+            break;
+
+        case ' ':
+            if (length > 0) {
+                toggle_mark(output, selected_result(output));
+            }
+            break;
+
+        default:
+            if (ch >= '0' && ch <= '9' && count < 100000000) {
+                ui->count = count * 10 + (ch - '0');
+            }
+            break;
+    }
     return 0;
 }
 
+/**
+ * Moves the selection by delta results. Moving onto the newest result
+ * follows the newest result as more arrive
+ */
+void move_selection(output_buffer_t *output, int delta) {
+    int length = output->line_list->length;
+    int selected = selected_result(output);
+
+    if (length == 0) {
+        return;
+    }
+    selected += delta;
+    if (selected >= length - 1) {
+        follow_newest(output);
+        return;
+    }
+    output->selected = selected < 0 ? 0 : selected;
+    output->following = 0;
+}
+
+/**
+ * Selects the newest result and keeps it selected as more arrive
+ */
+void follow_newest(output_buffer_t *output) {
+    int length = output->line_list->length;
+
+    output->selected = length > 0 ? length - 1 : 0;
+    output->following = 1;
+}
+
+/**
+ * Shifts the text of every row that does not fit the pane by delta columns.
+ * The shift is limited to what the visible rows can show when they are drawn
+ */
+void scroll_horizontally(output_buffer_t *output, int delta) {
+    output->hscroll += delta;
+    output->rows_dirty = 1;
+}
+
+/**
+ * Limits the horizontal scroll to the range that still moves one of the
+ * visible rows, so that scrolling back past the end of the longest line
+ * takes effect with the first key
+ */
+void clamp_hscroll(output_buffer_t *output, int start, int display_lines, int width) {
+    const result_span_t *span;
+    long low = 0, high = 0, window;
+    int text_width, i;
+
+    for (i = start; i < start + display_lines && i < output->line_list->length; i++) {
+        span = &output->spans[i];
+        text_width = width - 2 - (int)result_line_visible_length(output->line_list->lines[i], span->content);
+        if (text_width <= 0 || span->length - span->content <= (size_t)text_width) {
+            continue;
+        }
+        // where draw_result_row starts the window when not scrolled, before
+        // it is kept between the start of the text and its last text_width bytes
+        window = (long)span->match - text_width / 3;
+        if ((long)span->content - window < low) {
+            low = (long)span->content - window;
+        }
+        if ((long)span->length - text_width - window > high) {
+            high = (long)span->length - text_width - window;
+        }
+    }
+    if (output->hscroll < low) {
+        output->hscroll = (int)low;
+    } else if (output->hscroll > high) {
+        output->hscroll = (int)high;
+    }
+}
+
+/**
+ * Selects the result at index, clamped to the results received so far
+ */
+void select_result(output_buffer_t *output, int index) {
+    int length = output->line_list->length;
+
+    if (length == 0) {
+        return;
+    }
+    if (index >= length) {
+        index = length - 1;
+    }
+    output->selected = index < 0 ? 0 : index;
+    output->following = 0;
+}
+
+/**
+ * Returns the index of the selected result, or -1 when there are no results
+ */
+int selected_result(output_buffer_t *output) {
+    int length = output->line_list->length;
+
+    if (length == 0) {
+        return -1;
+    }
+    if (output->selected < 0 || output->following || output->selected >= length) {
+        return length - 1;
+    }
+    return output->selected;
+}
+
+/**
+ * Scrolls the output pane as little as possible to keep the selection in
+ * view, or to the newest results while following them. Returns the index
+ * of the result on the top row
+ */
+int update_display_start(output_buffer_t *output, int display_lines) {
+    int length = output->line_list->length;
+    int start = output->display_start;
+
+    if (output->selected < 0 || output->following || output->selected >= length) {
+        start = length > display_lines ? length - display_lines : 0;
+    } else if (output->selected < start) {
+        start = output->selected;
+    } else if (output->selected >= start + display_lines) {
+        start = output->selected - display_lines + 1;
+    }
+    if (start < 0) {
+        start = 0;
+    }
+    output->display_start = start;
+    return start;
+}
+
+/**
+ * Marks or unmarks the result at index. The marks grow with the results
+ * as they are marked, results past the end of the marks are unmarked
+ */
+void toggle_mark(output_buffer_t *output, int index) {
+    if (index < 0) {
+        return;
+    }
+    if (index >= output->marks_capacity) {
+        int capacity = output->marks_capacity ? output->marks_capacity : 64;
+
+        while (capacity <= index) {
+            capacity *= 2;
+        }
+        output->marks = realloc(output->marks, capacity);
+        if (output->marks == NULL) {
+            printf("ERROR: toggle_mark: failed to allocate");
+            exit(1);
+        }
+        memset(output->marks + output->marks_capacity, 0, capacity - output->marks_capacity);
+        output->marks_capacity = capacity;
+    }
+
+    output->marks[index] = !output->marks[index];
+    output->mark_count += output->marks[index] ? 1 : -1;
+    output->rows_dirty = 1;
+}
+
+int is_marked(output_buffer_t *output, int index) {
+    return index >= 0 && index < output->marks_capacity && output->marks[index];
+}
+
+void clear_marks(output_buffer_t *output) {
+    free(output->marks);
+    output->marks = NULL;
+    output->marks_capacity = 0;
+    output->mark_count = 0;
+}
+
 void kill_current_grep(grep_state_t *grep_state) {
     if (grep_state->current_grep_pid > 0) {
-        kill(grep_state->current_grep_pid, SIGTERM);
-        waitpid(grep_state->current_grep_pid, NULL, WNOHANG);
+        stop_backend(grep_state, grep_state->current_grep_pid);
         grep_state->current_grep_pid = 0;
     }
+    stream_cancel(event_stream);
     if (grep_state->pipe_read_fd > 0) {
         close(grep_state->pipe_read_fd);
         grep_state->pipe_read_fd = 0;
     }
+    grep_state->pending_length = 0;
+    if (grep_state->waiting_patterns) {
+        line_list_deallocate(&grep_state->waiting_patterns);
+    }
+    result_cache_refresh_release(&grep_state->cache_refresh, 0);
+}
+
+/**
+ * Asks a backend and everything it started to stop. Backends usually take
+ * a moment to exit, so they are reaped later by reap_backends; when
+ * MAX_EXITING_BACKENDS are still on their way out the oldest is killed and
+ * waited for, so fast typing never piles up searches competing for the CPU
+ */
+void stop_backend(grep_state_t *grep_state, pid_t pid) {
+    if (kill(-pid, SIGTERM) != 0) {
+        kill(pid, SIGTERM);
+    }
+    if (waitpid(pid, NULL, WNOHANG) != 0) {
+        return;
+    }
+    if (grep_state->exiting_count == MAX_EXITING_BACKENDS) {
+        kill(-grep_state->exiting[0], SIGKILL);
+        waitpid(grep_state->exiting[0], NULL, 0);
+        grep_state->exiting_count--;
+        memmove(grep_state->exiting, grep_state->exiting + 1, grep_state->exiting_count * sizeof(pid_t));
+    }
+    grep_state->exiting[grep_state->exiting_count++] = pid;
+}
+
+/**
+ * Collects the stopped backends that have exited since the last call
+ */
+void reap_backends(grep_state_t *grep_state) {
+    int i = 0;
+
+    while (i < grep_state->exiting_count) {
+        if (waitpid(grep_state->exiting[i], NULL, WNOHANG) != 0) {
+            grep_state->exiting_count--;
+            memmove(grep_state->exiting + i, grep_state->exiting + i + 1,
+                    (grep_state->exiting_count - i) * sizeof(pid_t));
+        } else {
+            i++;
+        }
+    }
+}
+
+/**
+ * Sleeps until a key is pressed, the backend has written something, the
+ * event stream can take more events or the next frame is due. Without it the main loop polls in a busy loop, which
+ * keeps a CPU busy and leaves the UI with a spent time slice whenever a
+ * key arrives while the machine is loaded
+ */
+void wait_for_events(grep_state_t *grep_state) {
+    struct pollfd fds[3];
+    nfds_t count = 0;
+
+    fds[count].fd = STDIN_FILENO;
+    fds[count].events = POLLIN;
+    count++;
+    if (grep_state->pipe_read_fd > 0) {
+        fds[count].fd = grep_state->pipe_read_fd;
+        fds[count].events = POLLIN;
+        count++;
+    }
+    if (stream_pending(event_stream)) {
+        fds[count].fd = event_stream->fd;
+        fds[count].events = POLLOUT;
+        count++;
+    }
+    poll(fds, count, FRAME_INTERVAL_MS);
 }
 
 void update_keypress_time(grep_state_t *grep_state) {
@@ -383,6 +1785,13 @@ void update_keypress_time(grep_state_t *grep_state) {
     grep_state->timer_active = 1;
 }
 
+/**
+ * Returns 1 unless the backend is still running or waiting to be started
+ */
+int search_complete(grep_state_t *grep_state) {
+    return grep_state->pipe_read_fd <= 0 && grep_state->waiting_patterns == NULL;
+}
+
 int should_execute_grep(const char *pattern, grep_state_t *grep_state) {
     if (strlen(pattern) == 0) {
         return 0;
@@ -392,7 +1801,7 @@ int should_execute_grep(const char *pattern, grep_state_t *grep_state) {
         return 0;
     }
     
-    if (grep_state->current_grep_pid > 0) {
+    if (grep_state->current_grep_pid > 0 && !grep_state->multi_term) {
         return 0;
     }
     
@@ -411,3 +1820,12 @@ int should_execute_grep(const char *pattern, grep_state_t *grep_state) {
     return 0;
 }
 
+/**
+ * Milliseconds since the given time
+ */
+long elapsed_ms(const struct timeval *since) {
+    struct timeval now;
+
+    gettimeofday(&now, NULL);
+    return (now.tv_sec - since->tv_sec) * 1000 + (now.tv_usec - since->tv_usec) / 1000;
+}
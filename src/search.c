@@ -0,0 +1,347 @@
+#define _DEFAULT_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "search.h"
+
+#define MAX_PATH_LEN 4096
+#define MAX_THREADS 64
+
+#define COLOR_PATH "\033[35m\033[K"
+#define COLOR_LINENO "\033[32m\033[K"
+#define COLOR_SEPARATOR "\033[36m\033[K:\033[m\033[K"
+#define COLOR_END "\033[m\033[K"
+#define COLOR_MATCH "\033[01;31m\033[K"
+
+typedef struct {
+    char *path;
+    file_view_t view;
+    int opened;         // view was opened by the walker
+    int skip;           // unreadable or binary, nothing to scan
+    int chunk_count;
+    int chunks_done;
+    scan_result_t *results;     // one per chunk
+} file_job_t;
+
+typedef struct {
+    file_job_t *job;
+    int chunk;
+} search_task_t;
+
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+    search_task_t tasks[SEARCH_QUEUE_SIZE];
+    int head;
+    int count;
+    int walk_done;
+
+    pthread_mutex_t out_lock;
+    FILE *out;
+    const ac_automaton_t *ac;
+    const search_options_t *options;
+    file_scan_stats_t walker_stats;
+} search_ctx_t;
+
+typedef struct {
+    search_ctx_t *ctx;
+    pthread_t thread;
+    file_scan_stats_t stats;
+} search_worker_t;
+
+void search_options_init(search_options_t *options) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+    memset(options, 0, sizeof(search_options_t));
+    options->mode = FILE_SCAN_MMAP;
+    options->threads = cpus > 0 ? (int)cpus : 1;
+    options->chunk_size = SEARCH_CHUNK_SIZE;
+    options->color = 0;
+}
+
+static void push_task(search_ctx_t *ctx, file_job_t *job, int chunk) {
+    pthread_mutex_lock(&ctx->lock);
+    while (ctx->count == SEARCH_QUEUE_SIZE) {
+        pthread_cond_wait(&ctx->not_full, &ctx->lock);
+    }
+    ctx->tasks[(ctx->head + ctx->count) % SEARCH_QUEUE_SIZE].job = job;
+    ctx->tasks[(ctx->head + ctx->count) % SEARCH_QUEUE_SIZE].chunk = chunk;
+    ctx->count++;
+    pthread_cond_signal(&ctx->not_empty);
+    pthread_mutex_unlock(&ctx->lock);
+}
+
+/*
+ * Returns 0 once the walk is over and the queue is drained.
+ */
+static int pop_task(search_ctx_t *ctx, search_task_t *task) {
+    pthread_mutex_lock(&ctx->lock);
+    while (ctx->count == 0 && !ctx->walk_done) {
+        pthread_cond_wait(&ctx->not_empty, &ctx->lock);
+    }
+    if (ctx->count == 0) {
+        pthread_mutex_unlock(&ctx->lock);
+        return 0;
+    }
+    *task = ctx->tasks[ctx->head];
+    ctx->head = (ctx->head + 1) % SEARCH_QUEUE_SIZE;
+    ctx->count--;
+    pthread_cond_signal(&ctx->not_full);
+    pthread_mutex_unlock(&ctx->lock);
+    return 1;
+}
+
+/*
+ * Write line with every match highlighted the way grep --color does.
+ */
+static void write_highlighted(FILE *out, const ac_automaton_t *ac, const char *line, size_t len) {
+    size_t pos = 0, match_len;
+    long at;
+
+    while (ac != NULL && pos < len && (at = ac_find(ac, line + pos, len - pos, &match_len)) >= 0) {
+        fwrite(line + pos, 1, at, out);
+        fputs(COLOR_MATCH, out);
+        fwrite(line + pos + at, 1, match_len, out);
+        fputs(COLOR_END, out);
+        pos += at + match_len;
+    }
+    fwrite(line + pos, 1, len - pos, out);
+}
+
+/*
+ * Write every match of a finished job, numbering lines across chunks.
+ * This is where matched lines are copied out of the mapped file.
+ */
+static void emit_job(search_ctx_t *ctx, file_job_t *job) {
+    long offset = 0;
+    int c, i;
+
+    pthread_mutex_lock(&ctx->out_lock);
+    for (c = 0; c < job->chunk_count; c++) {
+        scan_result_t *result = &job->results[c];
+
+        for (i = 0; i < result->length; i++) {
+            scan_match_t *m = &result->matches[i];
+
+            if (ctx->options->color) {
+                fprintf(ctx->out, COLOR_PATH "%s" COLOR_END COLOR_SEPARATOR COLOR_LINENO "%ld" COLOR_END COLOR_SEPARATOR,
+                        job->path, offset + m->lineno);
+                write_highlighted(ctx->out, ctx->ac, m->line, m->len);
+            } else {
+                fprintf(ctx->out, "%s:%ld:", job->path, offset + m->lineno);
+                fwrite(m->line, 1, m->len, ctx->out);
+            }
+            fputc('\n', ctx->out);
+        }
+        offset += result->lines;
+    }
+    fflush(ctx->out);
+    pthread_mutex_unlock(&ctx->out_lock);
+}
+
+static void free_job(file_job_t *job) {
+    int c;
+
+    if (job->view.data) {
+        file_view_close(&job->view);
+    }
+    for (c = 0; c < job->chunk_count; c++) {
+        scan_result_clear(&job->results[c]);
+    }
+    free(job->results);
+    free(job->path);
+    free(job);
+}
+
+static void* worker_main(void *arg) {
+    search_worker_t *worker = arg;
+    search_ctx_t *ctx = worker->ctx;
+    search_task_t task;
+    file_job_t *job;
+    size_t start, end;
+    int last;
+
+    while (pop_task(ctx, &task)) {
+        job = task.job;
+
+        // single chunk jobs are opened by the worker that scans them
+        if (!job->opened) {
+            if (file_view_open(&job->view, job->path, ctx->options->mode, &worker->stats) != 0
+                || file_view_is_binary(&job->view)) {
+                job->skip = 1;
+            }
+        }
+
+        if (!job->skip) {
+            start = job->chunk_count == 1 ? 0 : task.chunk * ctx->options->chunk_size;
+            end = job->chunk_count == 1 ? job->view.size : start + ctx->options->chunk_size;
+            file_scan_chunk(&job->view, start, end, ctx->ac, &job->results[task.chunk]);
+        }
+
+        pthread_mutex_lock(&ctx->lock);
+        last = ++job->chunks_done == job->chunk_count;
+        pthread_mutex_unlock(&ctx->lock);
+
+        if (last) {
+            emit_job(ctx, job);
+            free_job(job);
+        }
+    }
+
+    return NULL;
+}
+
+/*
+ * Queue a file for scanning. Files larger than the chunk size are opened
+ * here so they can be split into chunks scanned by different workers.
+ */
+static void add_file(search_ctx_t *ctx, const char *path, off_t size) {
+    file_job_t *job = calloc(1, sizeof(file_job_t));
+    int c;
+
+    job->path = strdup(path);
+    job->chunk_count = 1;
+
+    if ((size_t)size > ctx->options->chunk_size) {
+        if (file_view_open(&job->view, path, ctx->options->mode, &ctx->walker_stats) != 0) {
+            free_job(job);
+            return;
+        }
+        job->opened = 1;
+        if (file_view_is_binary(&job->view)) {
+            job->skip = 1;
+        } else {
+            job->chunk_count = (int)((job->view.size + ctx->options->chunk_size - 1) / ctx->options->chunk_size);
+            if (job->chunk_count < 1) {
+                job->chunk_count = 1;
+            }
+        }
+    }
+
+    job->results = calloc(job->chunk_count, sizeof(scan_result_t));
+    for (c = 0; c < job->chunk_count; c++) {
+        push_task(ctx, job, c);
+    }
+}
+
+/*
+ * Recursively queue every regular file under path. Like grep -r, symbolic
+ * links found while walking are not followed.
+ */
+static void walk(search_ctx_t *ctx, const char *path) {
+    char child[MAX_PATH_LEN];
+    struct dirent *entry;
+    struct stat st;
+    DIR *dir;
+
+    dir = opendir(path);
+    if (dir == NULL) {
+        return;
+    }
+
+    while ((entry = readdir(dir)) != NULL) {
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) {
+            continue;
+        }
+        if (entry->d_type == DT_LNK) {
+            continue;
+        }
+        if (snprintf(child, sizeof(child), "%s/%s", path, entry->d_name) >= (int)sizeof(child)) {
+            continue;
+        }
+        if (fstatat(dirfd(dir), entry->d_name, &st, AT_SYMLINK_NOFOLLOW) != 0) {
+            continue;
+        }
+        if (S_ISDIR(st.st_mode)) {
+            walk(ctx, child);
+        } else if (S_ISREG(st.st_mode)) {
+            add_file(ctx, child, st.st_size);
+        }
+    }
+
+    closedir(dir);
+}
+
+static void add_stats(file_scan_stats_t *total, const file_scan_stats_t *stats) {
+    total->opens += stats->opens;
+    total->reads += stats->reads;
+    total->mmaps += stats->mmaps;
+    total->madvises += stats->madvises;
+    total->bytes += stats->bytes;
+}
+
+/*
+ * Search every root (a directory searched recursively, or a file) for lines
+ * containing any term of ac, or for every line if ac is NULL, writing
+ * "path:line:text" lines to out.
+ * Lines of one file are written together and in order, files are written
+ * in the order they finish. Returns 0, or -1 if a root could not be found.
+ */
+int search_run(line_list_t *roots, const ac_automaton_t *ac, search_options_t *options, FILE *out) {
+    search_ctx_t ctx;
+    search_worker_t workers[MAX_THREADS];
+    int thread_count = options->threads;
+    int result = 0;
+    struct stat st;
+    int i;
+
+    if (thread_count < 1) {
+        thread_count = 1;
+    }
+    if (thread_count > MAX_THREADS) {
+        thread_count = MAX_THREADS;
+    }
+
+    memset(&ctx, 0, sizeof(ctx));
+    pthread_mutex_init(&ctx.lock, NULL);
+    pthread_mutex_init(&ctx.out_lock, NULL);
+    pthread_cond_init(&ctx.not_empty, NULL);
+    pthread_cond_init(&ctx.not_full, NULL);
+    ctx.out = out;
+    ctx.ac = ac;
+    ctx.options = options;
+
+    for (i = 0; i < thread_count; i++) {
+        memset(&workers[i], 0, sizeof(search_worker_t));
+        workers[i].ctx = &ctx;
+        pthread_create(&workers[i].thread, NULL, worker_main, &workers[i]);
+    }
+
+    for (i = 0; i < roots->length; i++) {
+        if (stat(roots->lines[i], &st) != 0) {
+            pthread_mutex_lock(&ctx.out_lock);
+            fprintf(out, "rtgrep: %s: %s\n", roots->lines[i], strerror(errno));
+            pthread_mutex_unlock(&ctx.out_lock);
+            result = -1;
+        } else if (S_ISDIR(st.st_mode)) {
+            walk(&ctx, roots->lines[i]);
+        } else {
+            add_file(&ctx, roots->lines[i], S_ISREG(st.st_mode) ? st.st_size : 0);
+        }
+    }
+
+    pthread_mutex_lock(&ctx.lock);
+    ctx.walk_done = 1;
+    pthread_cond_broadcast(&ctx.not_empty);
+    pthread_mutex_unlock(&ctx.lock);
+
+    memset(&options->stats, 0, sizeof(options->stats));
+    add_stats(&options->stats, &ctx.walker_stats);
+    for (i = 0; i < thread_count; i++) {
+        pthread_join(workers[i].thread, NULL);
+        add_stats(&options->stats, &workers[i].stats);
+    }
+
+    pthread_mutex_destroy(&ctx.lock);
+    pthread_mutex_destroy(&ctx.out_lock);
+    pthread_cond_destroy(&ctx.not_empty);
+    pthread_cond_destroy(&ctx.not_full);
+    return result;
+}
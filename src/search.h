@@ -0,0 +1,23 @@
+#ifndef SEARCH_H
+#define SEARCH_H
+
+#include <stdio.h>
+#include "aho_corasick.h"
+#include "file_scan.h"
+#include "line_list.h"
+
+#define SEARCH_CHUNK_SIZE (8 * 1024 * 1024)
+#define SEARCH_QUEUE_SIZE 1024
+
+typedef struct {
+    file_scan_mode_t mode;
+    int threads;
+    size_t chunk_size;          // files larger than this are split across workers
+    int color;                  // color path and line number like grep --color
+    file_scan_stats_t stats;    // totals, filled in by search_run
+} search_options_t;
+
+void search_options_init(search_options_t *options);
+int search_run(line_list_t *roots, const ac_automaton_t *ac, search_options_t *options, FILE *out);
+
+#endif
@@ -0,0 +1,365 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include "stream.h"
+#include "result_line.h"
+
+#define STREAM_INITIAL_CAPACITY 4096
+
+stream_t* stream_init(int fd) {
+    stream_t *stream = calloc(1, sizeof(stream_t));
+
+    if (stream == NULL) {
+        printf("ERROR: stream_init: failed to allocate");
+        exit(1);
+    }
+    stream->fd = fd;
+    return stream;
+}
+
+/*
+ * Opens the file, FIFO or /dev/fd/N the events are written to. Opening a
+ * FIFO waits until the reader has opened it. Returns NULL when it cannot
+ * be opened.
+ */
+stream_t* stream_open(const char *path) {
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+
+    if (fd < 0) {
+        return NULL;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    return stream_init(fd);
+}
+
+static void reserve(char **buffer, size_t *capacity, size_t needed) {
+    size_t new_capacity = *capacity ? *capacity : STREAM_INITIAL_CAPACITY;
+
+    if (needed <= *capacity) {
+        return;
+    }
+    while (new_capacity < needed) {
+        new_capacity *= 2;
+    }
+    if ((*buffer = realloc(*buffer, new_capacity)) == NULL) {
+        printf("ERROR: stream: failed to allocate");
+        exit(1);
+    }
+    *capacity = new_capacity;
+}
+
+static void append(stream_t *stream, const char *data, size_t len) {
+    reserve(&stream->buffer, &stream->capacity, stream->length + len);
+    memcpy(stream->buffer + stream->length, data, len);
+    stream->length += len;
+}
+
+static void append_text(stream_t *stream, const char *text) {
+    append(stream, text, strlen(text));
+}
+
+static void append_number(stream_t *stream, long number) {
+    char digits[32];
+
+    append(stream, digits, snprintf(digits, sizeof(digits), "%ld", number));
+}
+
+/*
+ * Length of the UTF-8 character at s, or 0 if s does not start a valid
+ * one within len bytes.
+ */
+static size_t utf8_length(const unsigned char *s, size_t len) {
+    size_t expected, i;
+
+    if (s[0] < 0x80) {
+        return 1;
+    } else if (s[0] >= 0xC2 && s[0] <= 0xDF) {
+        expected = 2;
+    } else if (s[0] >= 0xE0 && s[0] <= 0xEF) {
+        expected = 3;
+    } else if (s[0] >= 0xF0 && s[0] <= 0xF4) {
+        expected = 4;
+    } else {
+        return 0;
+    }
+    if (expected > len) {
+        return 0;
+    }
+    for (i = 1; i < expected; i++) {
+        if ((s[i] & 0xC0) != 0x80) {
+            return 0;
+        }
+    }
+    return expected;
+}
+
+/*
+ * Appends text as a JSON string. Bytes that are not valid UTF-8 are sent
+ * as the Latin-1 character of the same value, so the output is always
+ * valid JSON.
+ */
+static void append_string(stream_t *stream, const char *text, size_t len) {
+    const unsigned char *p = (const unsigned char *)text;
+    const unsigned char *end = p + len;
+    char escape[8];
+    size_t run;
+
+    append(stream, "\"", 1);
+    while (p < end) {
+        if (*p == '"' || *p == '\\') {
+            escape[0] = '\\';
+            escape[1] = *p++;
+            append(stream, escape, 2);
+        } else if (*p < 0x20 || *p == 0x7F) {
+            append(stream, escape, snprintf(escape, sizeof(escape), "\\u%04x", *p++));
+        } else if ((run = utf8_length(p, end - p)) > 0) {
+            append(stream, (const char *)p, run);
+            p += run;
+        } else {
+            append(stream, escape, snprintf(escape, sizeof(escape), "\\u%04x", *p++));
+        }
+    }
+    append(stream, "\"", 1);
+}
+
+static void append_event(stream_t *stream, const char *event) {
+    append_text(stream, "{\"event\":\"");
+    append_text(stream, event);
+    append_text(stream, "\",\"generation\":");
+    append_number(stream, stream->generation);
+}
+
+/*
+ * Drops the results of the current generation that were not written yet.
+ * An event that was partly written is kept, so the reader gets whole lines.
+ */
+static void drop_results(stream_t *stream) {
+    size_t from = stream->results_from;
+    const char *p;
+
+    if (from == 0 && stream->partial) {
+        p = memchr(stream->buffer, '\n', stream->length);
+        from = p ? (size_t)(p - stream->buffer) + 1 : stream->length;
+    }
+    // every event after the start of the generation is a result
+    for (p = stream->buffer + from; p < stream->buffer + stream->length; p++) {
+        if (*p == '\n') {
+            stream->count--;
+        }
+    }
+    if (from < stream->length) {
+        stream->length = from;
+    }
+}
+
+static void end_generation(stream_t *stream, const char *event) {
+    if (stream == NULL || !stream->active) {
+        return;
+    }
+    if (strcmp(event, "cancelled") == 0) {
+        drop_results(stream);
+    }
+    append_event(stream, event);
+    append_text(stream, ",\"count\":");
+    append_number(stream, stream->count);
+    append_text(stream, "}\n");
+    stream->active = 0;
+}
+
+static void start_generation(stream_t *stream, int final) {
+    stream_cancel(stream);
+    stream->generation++;
+    stream->active = 1;
+    stream->count = 0;
+    append_event(stream, "start");
+    append_text(stream, ",\"pattern\":");
+    append_string(stream, stream->pattern, strlen(stream->pattern));
+    append_text(stream, final ? ",\"final\":true}\n" : "}\n");
+    stream->results_from = stream->length;
+}
+
+/*
+ * Starts a generation for a new query, cancelling the previous one if it
+ * has not ended yet
+ */
+void stream_start(stream_t *stream, const char *pattern) {
+    if (stream == NULL) {
+        return;
+    }
+    free(stream->pattern);
+    stream->pattern = strdup(pattern);
+    if (stream->pattern == NULL) {
+        printf("ERROR: stream_start: failed to allocate");
+        exit(1);
+    }
+    start_generation(stream, 0);
+}
+
+/*
+ * Starts a new generation for the same query, whose results replace those
+ * sent so far. A generation that has not sent any results yet is kept.
+ */
+void stream_restart(stream_t *stream) {
+    if (stream == NULL || stream->pattern == NULL || (stream->active && stream->count == 0)) {
+        return;
+    }
+    start_generation(stream, 0);
+}
+
+/*
+ * Starts the last generation, carrying the results printed on exit
+ */
+void stream_final(stream_t *stream) {
+    if (stream == NULL) {
+        return;
+    }
+    if (stream->pattern == NULL) {
+        stream->pattern = strdup("");
+        if (stream->pattern == NULL) {
+            printf("ERROR: stream_final: failed to allocate");
+            exit(1);
+        }
+    }
+    start_generation(stream, 1);
+}
+
+/*
+ * Sends a line of backend output as a result of the current generation.
+ * The line is split into path, line number, column and text after color
+ * escapes are removed. Without a column field (as printed by rg --vimgrep)
+ * the column is that of the first highlighted match. Numbers that are not
+ * known are sent as 0.
+ */
+void stream_result(stream_t *stream, const char *line, size_t len) {
+    size_t length, path_length = 0, content, match_content;
+    long fields[2] = {0, 0}, match;
+    const char *text, *p;
+    int field;
+
+    if (stream == NULL || !stream->active) {
+        return;
+    }
+    if (stream->length >= STREAM_MAX_BUFFER) {
+        end_generation(stream, "truncated");
+        return;
+    }
+    // lines may come straight from the read buffer, without a terminator
+    reserve(&stream->line, &stream->line_capacity, len + 1);
+    memcpy(stream->line, line, len);
+    stream->line[len] = '\0';
+    line = stream->line;
+    reserve(&stream->scratch, &stream->scratch_capacity, len + 1);
+    length = result_line_strip_ansi(line, stream->scratch, len + 1);
+
+    text = result_line_content(stream->scratch);
+    if (text != stream->scratch) {
+        path_length = strchr(stream->scratch, ':') - stream->scratch;
+        p = stream->scratch + path_length + 1;
+        for (field = 0; field < 2 && p < text; field++) {
+            fields[field] = strtol(p, (char **)&p, 10);
+            p++;
+        }
+    }
+    if (fields[1] == 0) {
+        content = result_line_content_offset(line);
+        match = result_line_match_offset(line, content);
+        if (match >= 0 && fields[0] > 0) {
+            match_content = result_line_visible_length(line, match) - result_line_visible_length(line, content);
+            fields[1] = (long)match_content + 1;
+        }
+    }
+
+    append_event(stream, "result");
+    append_text(stream, ",\"path\":");
+    append_string(stream, stream->scratch, path_length);
+    append_text(stream, ",\"line\":");
+    append_number(stream, fields[0]);
+    append_text(stream, ",\"column\":");
+    append_number(stream, fields[1]);
+    append_text(stream, ",\"text\":");
+    append_string(stream, text, length - (text - stream->scratch));
+    append_text(stream, "}\n");
+    stream->count++;
+}
+
+void stream_done(stream_t *stream) {
+    end_generation(stream, "done");
+}
+
+void stream_cancel(stream_t *stream) {
+    end_generation(stream, "cancelled");
+}
+
+int stream_pending(const stream_t *stream) {
+    return stream != NULL && stream->length > 0;
+}
+
+/*
+ * Writes as many buffered events as the reader takes without blocking.
+ * Returns -1 once the reader has gone away, 0 otherwise.
+ */
+int stream_flush(stream_t *stream) {
+    size_t written = 0;
+    ssize_t result;
+
+    if (stream == NULL) {
+        return 0;
+    }
+    while (written < stream->length) {
+        result = write(stream->fd, stream->buffer + written, stream->length - written);
+        if (result < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                break;
+            }
+            return -1;
+        }
+        written += result;
+    }
+    if (written > 0) {
+        stream->partial = stream->buffer[written - 1] != '\n';
+    }
+    stream->length -= written;
+    memmove(stream->buffer, stream->buffer + written, stream->length);
+    stream->results_from = stream->results_from > written ? stream->results_from - written : 0;
+    return 0;
+}
+
+/*
+ * Writes what is left, giving the reader up to STREAM_CLOSE_TIMEOUT_MS to
+ * take it, and closes the stream
+ */
+void stream_close(stream_t **stream) {
+    struct pollfd pfd;
+    struct timeval start, now;
+    long left;
+
+    if (stream == NULL || *stream == NULL) {
+        return;
+    }
+    gettimeofday(&start, NULL);
+    pfd.fd = (*stream)->fd;
+    pfd.events = POLLOUT;
+    while (stream_flush(*stream) == 0 && stream_pending(*stream)) {
+        gettimeofday(&now, NULL);
+        left = STREAM_CLOSE_TIMEOUT_MS - ((now.tv_sec - start.tv_sec) * 1000 + (now.tv_usec - start.tv_usec) / 1000);
+        if (left <= 0 || poll(&pfd, 1, (int)left) == 0) {
+            break;
+        }
+    }
+    close((*stream)->fd);
+    free((*stream)->pattern);
+    free((*stream)->buffer);
+    free((*stream)->line);
+    free((*stream)->scratch);
+    free(*stream);
+    *stream = NULL;
+}
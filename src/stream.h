@@ -0,0 +1,61 @@
+#ifndef STREAM_H
+#define STREAM_H
+
+#include <stddef.h>
+
+#define STREAM_CLOSE_TIMEOUT_MS 1000
+#define STREAM_MAX_BUFFER (4 * 1024 * 1024)
+
+/*
+ * Machine readable event stream for editor integrations, one JSON object
+ * per line:
+ *
+ *   {"event":"start","generation":1,"pattern":"foo"}
+ *   {"event":"result","generation":1,"path":"a.c","line":3,"column":5,"text":"int foo;"}
+ *   {"event":"done","generation":1,"count":1}
+ *   {"event":"cancelled","generation":1,"count":0}
+ *   {"event":"truncated","generation":1,"count":20000}
+ *
+ * Every query shown while typing starts a new generation, which ends with
+ * done once all its results were sent, or with cancelled when it is
+ * replaced first. Results of a cancelled generation that were not written
+ * yet are dropped. A generation ends with truncated once more than
+ * STREAM_MAX_BUFFER bytes wait for the reader, and its further results are
+ * dropped. count is the number of results the reader gets. With ranking,
+ * the generation is restarted with the ranked results whenever they change
+ * on screen. On exit a last generation with "final":true carries the
+ * results printed to stdout. Results are parsed and stripped of color, so
+ * readers never see ANSI escapes. Events are buffered and written without
+ * blocking, so a slow reader never holds up typing.
+ */
+
+typedef struct {
+    int fd;
+    long generation;
+    int active;             // the generation has not ended yet
+    long count;             // results sent in the generation
+    char *pattern;          // pattern of the last generation
+    char *buffer;           // events not written yet
+    size_t length;
+    size_t capacity;
+    size_t results_from;    // offset in buffer of the unwritten results of the generation
+    int partial;            // the buffer starts in the middle of an event
+    char *line;             // copy of the result line being sent
+    size_t line_capacity;
+    char *scratch;          // the line stripped of color escapes
+    size_t scratch_capacity;
+} stream_t;
+
+stream_t* stream_open(const char *path);
+stream_t* stream_init(int fd);
+void stream_start(stream_t *stream, const char *pattern);
+void stream_restart(stream_t *stream);
+void stream_final(stream_t *stream);
+void stream_result(stream_t *stream, const char *line, size_t len);
+void stream_done(stream_t *stream);
+void stream_cancel(stream_t *stream);
+int stream_pending(const stream_t *stream);
+int stream_flush(stream_t *stream);
+void stream_close(stream_t **stream);
+
+#endif
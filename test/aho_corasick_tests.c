@@ -0,0 +1,77 @@
+#include <stdio.h>
+#include <string.h>
+#include "aho_corasick.h"
+#include "test_utils.h"
+
+static uint64_t scan(ac_automaton_t *ac, const char *text) {
+    return ac_scan(ac, text, strlen(text));
+}
+
+void test_ac_single_term() {
+    char *terms[] = {"needle"};
+    ac_automaton_t *ac = ac_build(terms, 1);
+
+    test_assert(scan(ac, "haystack with needle inside") == 1, "ac_scan finds a single term");
+    test_assert(scan(ac, "haystack with needl") == 0, "ac_scan rejects a partial term");
+    test_assert(scan(ac, "") == 0, "ac_scan handles empty text");
+
+    ac_deallocate(&ac);
+    test_assert(ac == NULL, "ac_deallocate sets pointer to NULL");
+}
+
+void test_ac_multiple_terms() {
+    char *terms[] = {"he", "she", "his", "hers"};
+    ac_automaton_t *ac = ac_build(terms, 4);
+
+    test_assert(scan(ac, "ushers") == (1 | 2 | 8), "ac_scan reports overlapping terms");
+    test_assert(scan(ac, "this") == 4, "ac_scan finds term found through failure link");
+    test_assert(scan(ac, "nothing") == 0, "ac_scan reports no terms when none occur");
+
+    ac_deallocate(&ac);
+}
+
+void test_ac_nested_terms() {
+    char *terms[] = {"abcd", "bc", "c"};
+    ac_automaton_t *ac = ac_build(terms, 3);
+
+    test_assert(scan(ac, "xabcx") == (2 | 4), "ac_scan reports terms nested in a longer partial match");
+    test_assert(scan(ac, "abcd") == (1 | 2 | 4), "ac_scan reports all terms ending inside a match");
+
+    ac_deallocate(&ac);
+}
+
+void test_ac_binary_bytes() {
+    char *terms[] = {"\xff\x01", ""};
+    ac_automaton_t *ac = ac_build(terms, 2);
+    char text[] = {'a', (char)0xff, 0x01, 'b'};
+
+    test_assert(ac_scan(ac, text, sizeof(text)) == 1, "ac_scan handles high bytes and ignores empty terms");
+
+    ac_deallocate(&ac);
+}
+
+void test_ac_find() {
+    char *terms[] = {"he", "hers", "is"};
+    ac_automaton_t *ac = ac_build(terms, 3);
+    size_t len = 0;
+
+    test_assert(ac_find(ac, "this", 4, &len) == 2 && len == 2, "ac_find returns offset and length of a match");
+    test_assert(ac_find(ac, "ushers", 6, &len) == 2 && len == 2, "ac_find returns the match that ends first");
+    test_assert(ac_find(ac, "nothing", 7, &len) == -1, "ac_find reports no match");
+
+    ac_deallocate(&ac);
+}
+
+int run_aho_corasick_tests() {
+    reset_test_counters();
+    printf("Running aho_corasick tests...\n");
+
+    test_ac_single_term();
+    test_ac_multiple_terms();
+    test_ac_nested_terms();
+    test_ac_binary_bytes();
+    test_ac_find();
+
+    printf("\nAho-Corasick tests completed: %d/%d passed\n", test_passed, test_count);
+    return (test_passed == test_count) ? 0 : 1;
+}
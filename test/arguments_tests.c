@@ -2,6 +2,7 @@
 #include <string.h>
 #include <assert.h>
 #include "arguments.h"
+#include "governor.h"
 #include "test_utils.h"
 
 void test_basic_pattern_only() {
@@ -107,6 +108,128 @@ void test_pattern_only() {
 
 }
 
+void test_cache_flag() {
+    char* argv[] = {"rtgrep", "-c", "pattern"};
+    int argc = 3;
+    
+    arguments_t* args = get_cli_arguments(argc, argv);
+    
+    test_assert(args->use_cache == 1, "-c enables the result cache");
+    test_assert(strcmp(args->pattern, "pattern") == 0, "pattern is set alongside -c");
+    
+    deallocate_arguments(&args);
+}
+
+void test_cache_disabled_by_default() {
+    char* argv[] = {"rtgrep", "pattern"};
+    int argc = 2;
+    
+    arguments_t* args = get_cli_arguments(argc, argv);
+    
+    test_assert(args->use_cache == 0, "result cache is disabled by default");
+    
+    deallocate_arguments(&args);
+}
+
+void test_multi_term_flag() {
+    char* argv[] = {"rtgrep", "-m", "foo bar"};
+    int argc = 3;
+    
+    arguments_t* args = get_cli_arguments(argc, argv);
+    
+    test_assert(args->multi_term == 1, "-m enables multi-term queries");
+    test_assert(strcmp(args->pattern, "foo bar") == 0, "multi-term pattern is kept whole");
+    
+    deallocate_arguments(&args);
+}
+
+void test_builtin_flag() {
+    char* argv[] = {"rtgrep", "-b", "-m", "needle"};
+    int argc = 4;
+    
+    arguments_t* args = get_cli_arguments(argc, argv);
+    
+    test_assert(args->builtin == 1, "-b selects the in-process backend");
+    test_assert(args->multi_term == 1, "-b combines with -m");
+    
+    deallocate_arguments(&args);
+}
+
+void test_preview_flag() {
+    char* argv[] = {"rtgrep", "-p", "5", "pattern"};
+    int argc = 4;
+    
+    arguments_t* args = get_cli_arguments(argc, argv);
+    
+    test_assert(args->preview_context == 5, "-p sets the preview context");
+    test_assert(strcmp(args->pattern, "pattern") == 0, "pattern is set alongside -p");
+    
+    deallocate_arguments(&args);
+}
+
+void test_preview_disabled_by_default() {
+    char* argv[] = {"rtgrep", "pattern"};
+    int argc = 2;
+    
+    arguments_t* args = get_cli_arguments(argc, argv);
+    
+    test_assert(args->preview_context == 0, "preview pane is hidden by default");
+    
+    deallocate_arguments(&args);
+}
+
+void test_top_k_flag() {
+    char* argv[] = {"rtgrep", "-k", "50", "-m", "pattern"};
+    int argc = 5;
+    
+    arguments_t* args = get_cli_arguments(argc, argv);
+    
+    test_assert(args->top_k == 50, "-k sets the number of ranked results");
+    test_assert(args->multi_term == 1, "-k combines with -m");
+    
+    deallocate_arguments(&args);
+}
+
+void test_governor_flags() {
+    char* argv[] = {"rtgrep", "-n", "19", "-j", "2", "-G", "/sys/fs/cgroup/rtgrep", "pattern"};
+    int argc = 8;
+    
+    arguments_t* args = get_cli_arguments(argc, argv);
+    
+    test_assert(args->nice == 19, "-n sets the niceness of searches");
+    test_assert(args->max_workers == 2, "-j caps the worker threads");
+    test_assert(args->cgroup != NULL && strcmp(args->cgroup, "/sys/fs/cgroup/rtgrep") == 0, "-G sets the cgroup");
+    test_assert(args->pattern != NULL && strcmp(args->pattern, "pattern") == 0, "pattern follows the governor flags");
+    
+    deallocate_arguments(&args);
+}
+
+void test_governor_defaults() {
+    char* argv[] = {"rtgrep", "pattern"};
+    int argc = 2;
+    
+    arguments_t* args = get_cli_arguments(argc, argv);
+    
+    test_assert(args->nice == GOVERNOR_DEFAULT_NICE, "searches run niced by default");
+    test_assert(args->max_workers == 0, "worker threads are not capped by default");
+    test_assert(args->cgroup == NULL, "no cgroup is used by default");
+    
+    deallocate_arguments(&args);
+}
+
+void test_stream_flag() {
+    char* argv[] = {"rtgrep", "-o", "/tmp/rtgrep.fifo", "-b"};
+    int argc = 4;
+    
+    arguments_t* args = get_cli_arguments(argc, argv);
+    
+    test_assert(args->stream_path != NULL && strcmp(args->stream_path, "/tmp/rtgrep.fifo") == 0, "-o sets the stream path");
+    test_assert(args->builtin == 1, "-o combines with -b");
+    test_assert(args->pattern == NULL, "-o takes its argument, not the pattern");
+    
+    deallocate_arguments(&args);
+}
+
 int run_arguments_tests() {
     reset_test_counters();
     printf("Running arguments tests...\n");
@@ -118,6 +241,16 @@ int run_arguments_tests() {
     test_empty_strings();
     test_complex_strings();
     test_pattern_only();
+    test_cache_flag();
+    test_cache_disabled_by_default();
+    test_multi_term_flag();
+    test_builtin_flag();
+    test_preview_flag();
+    test_preview_disabled_by_default();
+    test_top_k_flag();
+    test_governor_flags();
+    test_governor_defaults();
+    test_stream_flag();
     
     printf("\nArguments tests completed: %d/%d passed\n", test_passed, test_count);
     return (test_passed == test_count) ? 0 : 1;
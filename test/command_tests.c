@@ -0,0 +1,80 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "command.h"
+#include "line_list.h"
+#include "test_utils.h"
+
+void test_shell_quote_plain() {
+    char *quoted = command_shell_quote("foo bar");
+
+    test_assert(strcmp(quoted, "'foo bar'") == 0, "shell_quote wraps in single quotes");
+    free(quoted);
+}
+
+void test_shell_quote_special() {
+    char *quoted = command_shell_quote("it's $HOME \"x\"");
+
+    test_assert(strcmp(quoted, "'it'\\''s $HOME \"x\"'") == 0, "shell_quote escapes single quotes only");
+    free(quoted);
+}
+
+void test_build_whole_tree() {
+    char *cmd = command_build("grep -rn", "main", NULL);
+
+    test_assert(strcmp(cmd, "grep -rn 'main' .") == 0, "command_build searches current directory without targets");
+    free(cmd);
+}
+
+void test_build_targets() {
+    line_list_t *targets = line_list_init();
+    char *cmd;
+
+    line_list_add(targets, 8, "./a file");
+    line_list_add(targets, 5, "./b.c");
+    cmd = command_build("grep -rn", "x", targets);
+
+    test_assert(strcmp(cmd, "grep -rn 'x' './a file' './b.c' /dev/null") == 0, "command_build quotes targets and appends /dev/null");
+    free(cmd);
+    line_list_deallocate(&targets);
+}
+
+void test_build_several_patterns() {
+    line_list_t *patterns = line_list_init();
+    char *cmd;
+
+    line_list_add(patterns, 3, "foo");
+    line_list_add(patterns, 3, "bar");
+    cmd = command_build_patterns("grep -rn", patterns, NULL);
+
+    test_assert(strcmp(cmd, "grep -rn -e 'foo' -e 'bar' .") == 0, "command_build_patterns passes several patterns with -e");
+    free(cmd);
+    line_list_deallocate(&patterns);
+}
+
+void test_options() {
+    test_assert(command_options("grep -rn --color=always") == 0, "command_options finds nothing in the default command");
+    test_assert(command_options("grep -rnF") == COMMAND_FIXED_STRINGS, "command_options finds -F among combined options");
+    test_assert(command_options("/usr/bin/fgrep -rn") == COMMAND_FIXED_STRINGS, "command_options knows fgrep");
+    test_assert(command_options("rg --fixed-strings --ignore-case") == (COMMAND_FIXED_STRINGS | COMMAND_IGNORE_CASE),
+                "command_options reads long options");
+    test_assert(command_options("rg -i --vimgrep -S") == COMMAND_SMART_CASE, "the last case option wins");
+    test_assert(command_options("rg -S --case-sensitive") == 0, "--case-sensitive turns case folding off");
+    test_assert(command_options("rg -g*.ini -m1") == 0, "option values are not read as options");
+    test_assert(command_options("grep -rn -- -i") == 0, "options end at --");
+}
+
+int run_command_tests() {
+    reset_test_counters();
+    printf("Running command tests...\n");
+
+    test_shell_quote_plain();
+    test_shell_quote_special();
+    test_build_whole_tree();
+    test_build_targets();
+    test_build_several_patterns();
+    test_options();
+
+    printf("\nCommand tests completed: %d/%d passed\n", test_passed, test_count);
+    return (test_passed == test_count) ? 0 : 1;
+}
@@ -0,0 +1,281 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "file_scan.h"
+#include "search.h"
+#include "line_list.h"
+#include "test_utils.h"
+
+static char scan_tmp_dir[] = "/tmp/rtgrep_scan_testXXXXXX";
+static char small_path[256];
+static char large_path[256];
+
+static ac_automaton_t* build_ac(char *term) {
+    return ac_build(&term, 1);
+}
+
+/*
+ * Writes lines "line N" for N in [1, count], with "match" appended to
+ * every line divisible by every.
+ */
+static void write_numbered(const char *path, int count, int every) {
+    FILE *f = fopen(path, "w");
+    int i;
+
+    for (i = 1; i <= count; i++) {
+        fprintf(f, "line %d%s\n", i, i % every == 0 ? " match" : "");
+    }
+    fclose(f);
+}
+
+void test_view_small_file_is_read() {
+    file_scan_stats_t stats = {0};
+    file_view_t view;
+
+    test_assert(file_view_open(&view, small_path, FILE_SCAN_MMAP, &stats) == 0, "file_view_open opens small file");
+    test_assert(view.mapped == 0, "small files fall back to read()");
+    test_assert(stats.mmaps == 0 && stats.reads > 0, "small file read is counted");
+    file_view_close(&view);
+    test_assert(view.data == NULL, "file_view_close resets the view");
+}
+
+void test_view_large_file_is_mapped() {
+    file_scan_stats_t stats = {0};
+    file_view_t view;
+
+    test_assert(file_view_open(&view, large_path, FILE_SCAN_MMAP, &stats) == 0, "file_view_open opens large file");
+    test_assert(view.mapped == 1, "large files are mapped");
+    test_assert(stats.mmaps == 1 && stats.madvises == 2 && stats.reads == 0, "mapping is advised and needs no read()");
+    file_view_close(&view);
+
+    memset(&stats, 0, sizeof(stats));
+    test_assert(file_view_open(&view, large_path, FILE_SCAN_READ, &stats) == 0, "read mode opens large file");
+    test_assert(view.mapped == 0 && stats.reads > 1, "read mode reads in blocks");
+    file_view_close(&view);
+}
+
+void test_view_special_file() {
+    file_scan_stats_t stats = {0};
+    file_view_t view;
+
+    test_assert(file_view_open(&view, "/dev/null", FILE_SCAN_MMAP, &stats) == 0, "special files are read");
+    test_assert(view.size == 0 && view.mapped == 0, "special file read to EOF");
+    file_view_close(&view);
+}
+
+void test_scan_whole_file() {
+    file_scan_stats_t stats = {0};
+    scan_result_t result = {0};
+    ac_automaton_t *ac = build_ac("match");
+    file_view_t view;
+
+    file_view_open(&view, small_path, FILE_SCAN_MMAP, &stats);
+    file_scan_chunk(&view, 0, view.size, ac, &result);
+
+    test_assert(result.lines == 100, "scan counts every line");
+    test_assert(result.length == 10, "scan finds every matching line");
+    test_assert(result.matches[0].lineno == 10, "scan numbers matching lines");
+    test_assert(result.matches[0].len == strlen("line 10 match")
+                && strncmp(result.matches[0].line, "line 10 match", result.matches[0].len) == 0,
+                "match points at the line without its newline");
+    test_assert(result.matches[0].line >= view.data && result.matches[0].line < view.data + view.size,
+                "match references the file view without copying");
+
+    scan_result_clear(&result);
+    file_view_close(&view);
+    ac_deallocate(&ac);
+}
+
+void test_scan_chunks_cover_file_once() {
+    file_scan_stats_t stats = {0};
+    scan_result_t whole = {0};
+    scan_result_t chunks[7];
+    ac_automaton_t *ac = build_ac("match");
+    file_view_t view;
+    size_t chunk_size;
+    long offset = 0;
+    int c, i, found = 0, in_order = 1, lines = 0;
+
+    file_view_open(&view, large_path, FILE_SCAN_MMAP, &stats);
+    file_scan_chunk(&view, 0, view.size, ac, &whole);
+
+    // an odd chunk size so boundaries fall in the middle of lines
+    chunk_size = view.size / 7 + 1;
+    for (c = 0; c < 7; c++) {
+        memset(&chunks[c], 0, sizeof(scan_result_t));
+        file_scan_chunk(&view, c * chunk_size, (c + 1) * chunk_size, ac, &chunks[c]);
+        for (i = 0; i < chunks[c].length; i++) {
+            if (found >= whole.length || whole.matches[found].lineno != offset + chunks[c].matches[i].lineno
+                || whole.matches[found].line != chunks[c].matches[i].line) {
+                in_order = 0;
+            }
+            found++;
+        }
+        offset += chunks[c].lines;
+        lines += chunks[c].lines;
+        scan_result_clear(&chunks[c]);
+    }
+
+    test_assert(lines == whole.lines, "chunks count each line exactly once");
+    test_assert(found == whole.length, "chunks find the same number of matches");
+    test_assert(in_order, "chunk matches renumber to whole file line numbers");
+
+    scan_result_clear(&whole);
+    file_view_close(&view);
+    ac_deallocate(&ac);
+}
+
+void test_scan_last_line_without_newline() {
+    char path[300];
+    file_scan_stats_t stats = {0};
+    scan_result_t result = {0};
+    ac_automaton_t *ac = build_ac("end");
+    file_view_t view;
+    FILE *f;
+
+    snprintf(path, sizeof(path), "%s/nonl.txt", scan_tmp_dir);
+    f = fopen(path, "w");
+    fputs("first\nthe end", f);
+    fclose(f);
+
+    file_view_open(&view, path, FILE_SCAN_MMAP, &stats);
+    file_scan_chunk(&view, 0, view.size, ac, &result);
+    test_assert(result.length == 1 && result.matches[0].lineno == 2 && result.matches[0].len == 7,
+                "scan matches a final line without newline");
+
+    scan_result_clear(&result);
+    file_scan_chunk(&view, 0, view.size, NULL, &result);
+    test_assert(result.length == 2, "scan without an automaton matches every line");
+
+    scan_result_clear(&result);
+    file_view_close(&view);
+    ac_deallocate(&ac);
+    unlink(path);
+}
+
+void test_binary_detection() {
+    file_view_t view;
+    char text[] = "plain text";
+    char binary[] = {'E', 'L', 'F', '\0', 'x'};
+
+    view.data = text;
+    view.size = sizeof(text) - 1;
+    test_assert(!file_view_is_binary(&view), "text is not binary");
+    view.data = binary;
+    view.size = sizeof(binary);
+    test_assert(file_view_is_binary(&view), "NUL bytes mark a file binary");
+}
+
+void test_search_run_chunked() {
+    search_options_t options;
+    line_list_t *roots = line_list_init();
+    ac_automaton_t *ac = build_ac("match");
+    char line[512], expected[512];
+    FILE *out = tmpfile();
+    int count = 0, small = 0, last_large = 0, ordered = 1;
+
+    line_list_add(roots, strlen(scan_tmp_dir), scan_tmp_dir);
+    search_options_init(&options);
+    options.threads = 4;
+    options.chunk_size = 4096;  // forces the large file into many chunks
+
+    test_assert(search_run(roots, ac, &options, out) == 0, "search_run succeeds");
+
+    rewind(out);
+    while (fgets(line, sizeof(line), out)) {
+        int n;
+
+        count++;
+        if (strstr(line, "small.txt")) {
+            small++;
+        } else if (sscanf(strrchr(line, '/'), "/large.txt:%d:", &n) == 1) {
+            snprintf(expected, sizeof(expected), "%s:%d:line %d match\n", large_path, n, n);
+            if (n <= last_large || strcmp(line, expected) != 0) {
+                ordered = 0;
+            }
+            last_large = n;
+        }
+    }
+
+    test_assert(count == 10 + 2000, "search_run reports every match in the tree");
+    test_assert(small == 10, "search_run reports matches of small files");
+    test_assert(ordered, "chunked file matches are written in order with correct line numbers");
+    test_assert(options.stats.mmaps == 1, "only the large file is mapped");
+
+    fclose(out);
+    ac_deallocate(&ac);
+    line_list_deallocate(&roots);
+}
+
+void test_search_run_color() {
+    search_options_t options;
+    line_list_t *roots = line_list_init();
+    ac_automaton_t *ac = build_ac("match");
+    char line[512], expected[512];
+    FILE *out = tmpfile();
+
+    line_list_add(roots, strlen(small_path), small_path);
+    search_options_init(&options);
+    options.color = 1;
+    search_run(roots, ac, &options, out);
+
+    rewind(out);
+    snprintf(expected, sizeof(expected), "\033[35m\033[K%s\033[m\033[K\033[36m\033[K:\033[m\033[K"
+             "\033[32m\033[K10\033[m\033[K\033[36m\033[K:\033[m\033[Kline 10 \033[01;31m\033[Kmatch\033[m\033[K\n",
+             small_path);
+    test_assert(fgets(line, sizeof(line), out) && strcmp(line, expected) == 0,
+                "colored output highlights matches like grep");
+
+    fclose(out);
+    ac_deallocate(&ac);
+    line_list_deallocate(&roots);
+}
+
+void test_search_run_missing_root() {
+    search_options_t options;
+    line_list_t *roots = line_list_init();
+    ac_automaton_t *ac = build_ac("x");
+    FILE *out = tmpfile();
+
+    line_list_add(roots, 17, "/nonexistent/path");
+    search_options_init(&options);
+    test_assert(search_run(roots, ac, &options, out) == -1, "search_run reports a missing root");
+
+    fclose(out);
+    ac_deallocate(&ac);
+    line_list_deallocate(&roots);
+}
+
+int run_file_scan_tests() {
+    reset_test_counters();
+    printf("Running file_scan tests...\n");
+
+    if (mkdtemp(scan_tmp_dir) == NULL) {
+        test_assert(0, "create temporary scan directory");
+        return 1;
+    }
+    snprintf(small_path, sizeof(small_path), "%s/small.txt", scan_tmp_dir);
+    snprintf(large_path, sizeof(large_path), "%s/large.txt", scan_tmp_dir);
+    write_numbered(small_path, 100, 10);
+    write_numbered(large_path, 20000, 10);
+
+    test_view_small_file_is_read();
+    test_view_large_file_is_mapped();
+    test_view_special_file();
+    test_scan_whole_file();
+    test_scan_chunks_cover_file_once();
+    test_scan_last_line_without_newline();
+    test_binary_detection();
+    test_search_run_chunked();
+    test_search_run_color();
+    test_search_run_missing_root();
+
+    unlink(small_path);
+    unlink(large_path);
+    rmdir(scan_tmp_dir);
+
+    printf("\nFile scan tests completed: %d/%d passed\n", test_passed, test_count);
+    return (test_passed == test_count) ? 0 : 1;
+}
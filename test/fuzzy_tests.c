@@ -0,0 +1,156 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "fuzzy.h"
+#include "line_list.h"
+#include "test_utils.h"
+
+static int score(const char *query, const char *text) {
+    return fuzzy_score(query, strlen(query), text);
+}
+
+static void add(line_list_t *lines, const char *line) {
+    line_list_add(lines, strlen(line), (char *)line);
+}
+
+void test_score_matching() {
+    test_assert(score("abc", "xaxbxcx") >= 0, "characters in order match");
+    test_assert(score("abc", "cba") == -1, "characters out of order do not match");
+    test_assert(score("abcd", "abc") == -1, "every character of the query must appear");
+    test_assert(score("", "anything") == 0, "the empty query matches everything");
+    test_assert(score("main", "src/MAIN.c") >= 0, "lower case queries ignore case");
+    test_assert(score("Main", "src/main.c") == -1, "queries with upper case letters respect case");
+}
+
+void test_score_ordering() {
+    test_assert(score("rt", "src/rtgrep.c:1:x") > score("rt", "src/xrxt.c:1:x"),
+                "consecutive characters score higher than scattered ones");
+    test_assert(score("rank", "src/rank.c:1:x") > score("rank", "src/frank.c:1:x"),
+                "matches at the start of a path component score higher");
+    test_assert(score("ql", "query_line") > score("ql", "quell"), "matches at word starts score higher");
+    test_assert(score("ab", "a_b") > score("ab", "a___________b"), "longer gaps cost more");
+}
+
+void test_mask() {
+    uint64_t mask = fuzzy_mask("Src/Main.c", 10);
+
+    test_assert((mask & fuzzy_mask("main", 4)) == fuzzy_mask("main", 4), "signatures ignore case");
+    test_assert((mask & fuzzy_mask("mainz", 5)) != fuzzy_mask("mainz", 5), "signatures reject missing letters");
+    test_assert((fuzzy_mask("a.c", 3) & fuzzy_mask("9", 1)) == 0, "digits have their own bits");
+}
+
+void test_update_orders_by_score() {
+    fuzzy_t *fuzzy = fuzzy_init(1);
+    line_list_t *lines = line_list_init();
+    line_list_t *out = line_list_init();
+
+    fuzzy_update(fuzzy, lines, "rank");
+    test_assert(fuzzy->match_count == 0, "an empty list has no matches");
+
+    add(lines, "docs/notes.txt:1:rank");
+    add(lines, "src/rank.c:1:x");
+    add(lines, "src/other.c:1:nothing");
+    add(lines, "src/frank.c:1:x");
+
+    test_assert(fuzzy_update(fuzzy, lines, "rank") == 1, "fuzzy_update reports new lines");
+    test_assert(fuzzy->match_count == 3, "fuzzy_update keeps the matching lines");
+    fuzzy_results(fuzzy, lines, out);
+    test_assert(out->length == 3 && strcmp(out->lines[2], "src/rank.c:1:x") == 0, "the best match is last");
+    test_assert(fuzzy_update(fuzzy, lines, "rank") == 0, "an unchanged query and list is not scored again");
+
+    line_list_deallocate(&out);
+    line_list_deallocate(&lines);
+    fuzzy_deallocate(&fuzzy);
+    test_assert(fuzzy == NULL, "fuzzy_deallocate resets the pointer");
+}
+
+void test_update_is_incremental() {
+    fuzzy_t *fuzzy = fuzzy_init(1);
+    line_list_t *lines = line_list_init();
+
+    add(lines, "a/foo.c:1:x");
+    add(lines, "a/bar.c:1:x");
+    add(lines, "a/fob.c:1:x");
+    fuzzy_update(fuzzy, lines, "fo");
+    test_assert(fuzzy->match_count == 2, "fuzzy_update filters the first query");
+
+    // new lines are scored against the current query
+    add(lines, "b/fox.c:1:x");
+    add(lines, "b/baz.c:1:x");
+    fuzzy_update(fuzzy, lines, "fo");
+    test_assert(fuzzy->match_count == 3 && fuzzy->scanned == 5, "lines added later are filtered too");
+
+    // a longer query only rescores the previous matches
+    fuzzy_update(fuzzy, lines, "foo");
+    test_assert(fuzzy->match_count == 1, "a longer query narrows the matches");
+
+    // a query that is not an extension starts over
+    fuzzy_update(fuzzy, lines, "ba");
+    test_assert(fuzzy->match_count == 2, "a different query scores every line again");
+
+    fuzzy_update(fuzzy, lines, "");
+    test_assert(fuzzy->match_count == 5, "the empty query keeps every line");
+
+    line_list_clear(lines);
+    add(lines, "c/foo.c:1:x");
+    fuzzy_update(fuzzy, lines, "fo");
+    test_assert(fuzzy->match_count == 1 && fuzzy->matches[0].index == 0, "a cleared list starts over");
+
+    line_list_deallocate(&lines);
+    fuzzy_deallocate(&fuzzy);
+}
+
+void test_update_ignores_colors() {
+    fuzzy_t *fuzzy = fuzzy_init(1);
+    line_list_t *lines = line_list_init();
+
+    add(lines, "\033[35m\033[Ksrc/a.c\033[m\033[K:1:x");
+    fuzzy_update(fuzzy, lines, "a.c:");
+    test_assert(fuzzy->match_count == 1, "color escapes do not break up matches");
+    fuzzy_update(fuzzy, lines, "35m");
+    test_assert(fuzzy->match_count == 0, "color escapes are not matched");
+    test_assert(fuzzy->masks[0] == fuzzy_mask("src/a.c:1:x", 11), "color escapes are left out of signatures");
+
+    line_list_deallocate(&lines);
+    fuzzy_deallocate(&fuzzy);
+}
+
+void test_threaded_update() {
+    fuzzy_t *single = fuzzy_init(1);
+    fuzzy_t *threaded = fuzzy_init(4);
+    line_list_t *lines = line_list_init();
+    char line[64];
+    int i, same = 1;
+
+    for (i = 0; i < FUZZY_BATCH_SIZE * 3 + 17; i++) {
+        snprintf(line, sizeof(line), "dir%d/file%d.c:%d:text", i % 7, i, i);
+        add(lines, line);
+    }
+    fuzzy_update(single, lines, "d3f1");
+    fuzzy_update(threaded, lines, "d3f1");
+    same = single->match_count == threaded->match_count && single->match_count > 0;
+    for (i = 0; same && i < single->match_count; i++) {
+        same = single->order[i] == threaded->order[i];
+    }
+    test_assert(same, "threaded batches give the same results as one thread");
+
+    line_list_deallocate(&lines);
+    fuzzy_deallocate(&single);
+    fuzzy_deallocate(&threaded);
+}
+
+int run_fuzzy_tests() {
+    reset_test_counters();
+    printf("Running fuzzy tests...\n");
+
+    test_score_matching();
+    test_score_ordering();
+    test_mask();
+    test_update_orders_by_score();
+    test_update_is_incremental();
+    test_update_ignores_colors();
+    test_threaded_update();
+
+    printf("\nFuzzy tests completed: %d/%d passed\n", test_passed, test_count);
+    return (test_passed == test_count) ? 0 : 1;
+}
@@ -0,0 +1,97 @@
+#define _DEFAULT_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include "governor.h"
+#include "test_utils.h"
+
+/*
+ * Runs governor_enter_backend in a child, like rtgrep does for every
+ * backend, and returns the niceness the child ended up with, or -100 when
+ * the failures reported by governor_enter_backend differ from expected.
+ */
+static int niceness_in_backend(const governor_t *governor, int expected_failures) {
+    pid_t pid;
+    int status;
+
+    pid = fork();
+    if (pid == 0) {
+        int before = getpriority(PRIO_PROCESS, 0);
+        int failed = governor_enter_backend(governor);
+        // the ioprio call is not available everywhere, only check the rest
+        if ((failed & ~GOVERNOR_IOPRIO_FAILED) != expected_failures) {
+            _exit(0);
+        }
+        _exit(getpriority(PRIO_PROCESS, 0) - before + 100);
+    }
+    if (pid < 0 || waitpid(pid, &status, 0) != pid || !WIFEXITED(status)) {
+        return -100;
+    }
+    return WEXITSTATUS(status) - 100;
+}
+
+void test_governor_init() {
+    governor_t governor;
+
+    governor_init(&governor, 25, -3, NULL);
+    test_assert(governor.nice == GOVERNOR_MAX_NICE, "governor_init clamps the niceness");
+    test_assert(governor.max_workers == 0, "governor_init treats a negative cap as no cap");
+    test_assert(governor.cgroup[0] == '\0', "governor_init without a cgroup leaves it empty");
+
+    governor_init(&governor, 5, 2, "/sys/fs/cgroup/rtgrep");
+    test_assert(governor.nice == 5 && governor.max_workers == 2, "governor_init keeps valid limits");
+}
+
+void test_governor_workers() {
+    governor_t governor;
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+    governor_init(&governor, 0, 0, NULL);
+    test_assert(governor_workers(&governor) == (cpus > 0 ? cpus : 1), "without a cap there is a worker per CPU");
+
+    governor_init(&governor, 0, 1, NULL);
+    test_assert(governor_workers(&governor) == 1, "the cap limits the workers");
+
+    governor_init(&governor, 0, 100000, NULL);
+    test_assert(governor_workers(&governor) == (cpus > 0 ? cpus : 1), "a cap above the CPU count changes nothing");
+}
+
+void test_governor_ioprio() {
+    test_assert(governor_ioprio(0) == ((2 << 13) | 4), "niceness 0 maps to best effort level 4");
+    test_assert(governor_ioprio(10) == ((2 << 13) | 6), "niceness 10 maps to best effort level 6");
+    test_assert(governor_ioprio(GOVERNOR_MAX_NICE) == (3 << 13), "the lowest priority maps to the idle class");
+}
+
+void test_governor_enter_backend() {
+    governor_t governor;
+    int start = getpriority(PRIO_PROCESS, 0);
+
+    governor_init(&governor, 0, 0, NULL);
+    test_assert(niceness_in_backend(&governor, 0) == 0, "niceness 0 leaves the backend priority alone");
+
+    if (start <= 10) {
+        governor_init(&governor, 10, 0, NULL);
+        test_assert(niceness_in_backend(&governor, 0) == 10 - start, "the backend runs at the niceness");
+    }
+
+    governor_init(&governor, GOVERNOR_MAX_NICE, 0, "/nonexistent/rtgrep-cgroup");
+    test_assert(niceness_in_backend(&governor, GOVERNOR_CGROUP_FAILED) == GOVERNOR_MAX_NICE - start,
+                "a missing cgroup is reported and the niceness still applies");
+
+    test_assert(getpriority(PRIO_PROCESS, 0) == start, "the calling process keeps its priority");
+}
+
+int run_governor_tests() {
+    reset_test_counters();
+    printf("Running governor tests...\n");
+
+    test_governor_init();
+    test_governor_workers();
+    test_governor_ioprio();
+    test_governor_enter_backend();
+
+    printf("\nGovernor tests completed: %d/%d passed\n", test_passed, test_count);
+    return (test_passed == test_count) ? 0 : 1;
+}
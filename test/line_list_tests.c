@@ -82,6 +82,40 @@ void test_line_list_empty_string() {
     line_list_deallocate(&list);
 }
 
+void test_line_list_long_line() {
+    line_list_t* list = line_list_init();
+    int size = 200000;
+    char *line = malloc(size + 1);
+    
+    memset(line, 'x', size);
+    line[size] = '\0';
+    line[size - 1] = 'y';
+    line_list_add(list, 5, "short");
+    line_list_add(list, size, line);
+    line_list_add(list, 5, "after");
+    
+    test_assert(strlen(list->lines[1]) == (size_t)size && list->lines[1][size - 1] == 'y',
+                "line_list_add keeps lines larger than a block whole");
+    test_assert(strcmp(list->lines[0], "short") == 0 && strcmp(list->lines[2], "after") == 0,
+                "lines around a large line are kept");
+    
+    free(line);
+    line_list_deallocate(&list);
+}
+
+void test_line_list_add_ref() {
+    line_list_t* list = line_list_init();
+    char line[] = "borrowed";
+    
+    line_list_add_ref(list, line);
+    test_assert(list->length == 1 && list->lines[0] == line, "line_list_add_ref stores the line without copying");
+    
+    line_list_clear(list);
+    test_assert(list->length == 0 && strcmp(line, "borrowed") == 0, "line_list_clear leaves borrowed lines alone");
+    
+    line_list_deallocate(&list);
+}
+
 int run_line_list_tests() {
     reset_test_counters();
     printf("Running line_list tests...\n");
@@ -92,6 +126,8 @@ int run_line_list_tests() {
     test_line_list_clear();
     test_line_list_capacity_expansion();
     test_line_list_empty_string();
+    test_line_list_long_line();
+    test_line_list_add_ref();
     
     printf("\nLine list tests completed: %d/%d passed\n", test_passed, test_count);
     return (test_passed == test_count) ? 0 : 1;
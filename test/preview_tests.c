@@ -0,0 +1,173 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "preview.h"
+#include "line_list.h"
+#include "test_utils.h"
+
+static char preview_tmp_dir[] = "/tmp/rtgrep_preview_testXXXXXX";
+
+static void write_lines(const char *path, const char *prefix, int count, int trailing_newline) {
+    FILE *f = fopen(path, "w");
+    int i;
+
+    for (i = 1; i <= count; i++) {
+        fprintf(f, "%s %d%s", prefix, i, i < count || trailing_newline ? "\n" : "");
+    }
+    fclose(f);
+}
+
+/*
+ * Request path:line and wait (up to two seconds) for the worker to answer.
+ */
+static int fetch(preview_t *preview, const char *path, long line, line_list_t *lines, long *first_line) {
+    struct timespec pause = {0, 1000000};
+    char response_path[PREVIEW_MAX_PATH];
+    long response_line;
+    int i;
+
+    preview_request(preview, path, line);
+    for (i = 0; i < 2000; i++) {
+        if (preview_poll(preview, response_path, sizeof(response_path), lines, first_line, &response_line)) {
+            return strcmp(response_path, path) == 0 && response_line == line;
+        }
+        nanosleep(&pause, NULL);
+    }
+    return 0;
+}
+
+void test_context_lines() {
+    preview_t *preview = preview_init(2);
+    line_list_t *lines = line_list_init();
+    char path[256];
+    long first = 0;
+
+    snprintf(path, sizeof(path), "%s/context.txt", preview_tmp_dir);
+    write_lines(path, "line", 100, 1);
+
+    test_assert(fetch(preview, path, 50, lines, &first), "preview answers a request");
+    test_assert(first == 48 && lines->length == 5, "preview returns context on both sides");
+    test_assert(strcmp(lines->lines[0], "line 48") == 0 && strcmp(lines->lines[4], "line 52") == 0,
+                "preview context lines are sliced from the file");
+
+    test_assert(fetch(preview, path, 1, lines, &first), "preview answers a request for the first line");
+    test_assert(first == 1 && lines->length == 3, "preview context is clipped at the start of the file");
+
+    test_assert(fetch(preview, path, 100, lines, &first), "preview answers a request for the last line");
+    test_assert(first == 98 && lines->length == 3, "preview context is clipped at the end of the file");
+    test_assert(preview->stats.opens == 1, "moving within a file does not open it again");
+
+    unlink(path);
+    line_list_deallocate(&lines);
+    preview_deallocate(&preview);
+    test_assert(preview == NULL, "preview_deallocate resets the pointer");
+}
+
+void test_last_line_without_newline() {
+    preview_t *preview = preview_init(1);
+    line_list_t *lines = line_list_init();
+    char path[256];
+    long first = 0;
+
+    snprintf(path, sizeof(path), "%s/unterminated.txt", preview_tmp_dir);
+    write_lines(path, "line", 3, 0);
+
+    test_assert(fetch(preview, path, 3, lines, &first), "preview answers for an unterminated file");
+    test_assert(lines->length == 2 && strcmp(lines->lines[1], "line 3") == 0,
+                "preview keeps the last line without a newline");
+
+    unlink(path);
+    line_list_deallocate(&lines);
+    preview_deallocate(&preview);
+}
+
+void test_missing_file() {
+    preview_t *preview = preview_init(2);
+    line_list_t *lines = line_list_init();
+    char path[256];
+    long first = 0;
+
+    snprintf(path, sizeof(path), "%s/missing.txt", preview_tmp_dir);
+
+    test_assert(fetch(preview, path, 5, lines, &first), "preview answers for a missing file");
+    test_assert(lines->length == 0, "missing files have no context");
+
+    line_list_deallocate(&lines);
+    preview_deallocate(&preview);
+}
+
+void test_lru_is_bounded() {
+    preview_t *preview = preview_init(1);
+    line_list_t *lines = line_list_init();
+    char path[256];
+    long first = 0;
+    int ok = 1;
+    int i;
+
+    for (i = 0; i < PREVIEW_MAX_FILES + 4; i++) {
+        snprintf(path, sizeof(path), "%s/lru%d.txt", preview_tmp_dir, i);
+        write_lines(path, "file", 10, 1);
+        ok = ok && fetch(preview, path, 5, lines, &first);
+    }
+    test_assert(ok, "preview answers for every file");
+    test_assert(preview->file_count == PREVIEW_MAX_FILES, "at most PREVIEW_MAX_FILES files stay mapped");
+
+    // the most recently used file is still mapped, the oldest is not
+    snprintf(path, sizeof(path), "%s/lru%d.txt", preview_tmp_dir, PREVIEW_MAX_FILES + 3);
+    fetch(preview, path, 2, lines, &first);
+    test_assert(preview->stats.opens == PREVIEW_MAX_FILES + 4, "recent files are served from the cache");
+    snprintf(path, sizeof(path), "%s/lru0.txt", preview_tmp_dir);
+    fetch(preview, path, 2, lines, &first);
+    test_assert(preview->stats.opens == PREVIEW_MAX_FILES + 5, "evicted files are mapped again");
+
+    for (i = 0; i < PREVIEW_MAX_FILES + 4; i++) {
+        snprintf(path, sizeof(path), "%s/lru%d.txt", preview_tmp_dir, i);
+        unlink(path);
+    }
+    line_list_deallocate(&lines);
+    preview_deallocate(&preview);
+}
+
+void test_changed_file_is_reloaded() {
+    preview_t *preview = preview_init(0);
+    line_list_t *lines = line_list_init();
+    char path[256];
+    long first = 0;
+
+    snprintf(path, sizeof(path), "%s/changed.txt", preview_tmp_dir);
+    write_lines(path, "old", 10, 1);
+    fetch(preview, path, 4, lines, &first);
+    test_assert(lines->length == 1 && strcmp(lines->lines[0], "old 4") == 0, "preview shows the original file");
+
+    write_lines(path, "changed", 10, 1);
+    fetch(preview, path, 4, lines, &first);
+    test_assert(lines->length == 1 && strcmp(lines->lines[0], "changed 4") == 0, "preview reloads a changed file");
+
+    unlink(path);
+    line_list_deallocate(&lines);
+    preview_deallocate(&preview);
+}
+
+int run_preview_tests() {
+    reset_test_counters();
+    printf("Running preview tests...\n");
+
+    if (mkdtemp(preview_tmp_dir) == NULL) {
+        test_assert(0, "create temporary preview directory");
+        return 1;
+    }
+
+    test_context_lines();
+    test_last_line_without_newline();
+    test_missing_file();
+    test_lru_is_bounded();
+    test_changed_file_is_reloaded();
+
+    rmdir(preview_tmp_dir);
+
+    printf("\nPreview tests completed: %d/%d passed\n", test_passed, test_count);
+    return (test_passed == test_count) ? 0 : 1;
+}
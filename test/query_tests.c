@@ -0,0 +1,154 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "query.h"
+#include "line_list.h"
+#include "test_utils.h"
+
+static int matches(const char *query_text, const char *line) {
+    query_t *query = query_parse(query_text, QUERY_MATCH_CASE);
+    int result = query_matches_line(query, line);
+
+    query_deallocate(&query);
+    return result;
+}
+
+void test_query_parse_clauses() {
+    query_t *query = query_parse("foo bar|baz !qux", QUERY_MATCH_CASE);
+
+    test_assert(query->clause_count == 3, "query_parse splits clauses on spaces");
+    test_assert(query->term_count == 4, "query_parse collects every term");
+    test_assert(query->clauses[1].terms == (2 | 4), "query_parse groups | alternatives into one clause");
+    test_assert(query->clauses[2].negated == 1, "query_parse marks ! clauses as negated");
+
+    query_deallocate(&query);
+    test_assert(query == NULL, "query_deallocate sets pointer to NULL");
+}
+
+void test_query_parse_escapes() {
+    query_t *query = query_parse("a\\ b \\!c d\\|e", QUERY_MATCH_CASE);
+
+    test_assert(query->clause_count == 3, "escaped space does not split clauses");
+    test_assert(strcmp(query->terms[0], "a b") == 0, "escaped space is part of the term");
+    test_assert(strcmp(query->terms[1], "!c") == 0 && query->clauses[1].negated == 0, "escaped ! is literal");
+    test_assert(strcmp(query->terms[2], "d|e") == 0, "escaped | is literal");
+
+    query_deallocate(&query);
+}
+
+void test_query_parse_duplicates() {
+    query_t *query = query_parse("  foo   foo|bar  ", QUERY_MATCH_CASE);
+
+    test_assert(query->clause_count == 2, "extra spaces do not create clauses");
+    test_assert(query->term_count == 2, "repeated terms share an index");
+
+    query_deallocate(&query);
+}
+
+void test_query_and() {
+    test_assert(matches("foo bar", "f.c:1:foo and bar"), "AND matches when all terms present");
+    test_assert(!matches("foo bar", "f.c:1:only foo"), "AND rejects when a term is missing");
+}
+
+void test_query_or() {
+    test_assert(matches("foo|bar", "f.c:1:has bar"), "OR matches either term");
+    test_assert(!matches("foo|bar", "f.c:1:has baz"), "OR rejects when no term present");
+}
+
+void test_query_not() {
+    test_assert(matches("foo !bar", "f.c:1:foo only"), "NOT matches when term absent");
+    test_assert(!matches("foo !bar", "f.c:1:foo bar"), "NOT rejects when term present");
+    test_assert(!matches("foo !bar|baz", "f.c:1:foo baz"), "negated OR rejects any alternative");
+}
+
+void test_query_ignores_prefix_and_color() {
+    const char *line = "\033[35m\033[Kfoo.c\033[m\033[K\033[36m\033[K:\033[m\033[K"
+                       "\033[32m\033[K42\033[m\033[K\033[36m\033[K:\033[m\033[Kcall(\033[01;31m\033[Kx\033[m\033[K)";
+
+    test_assert(!matches("foo", "foo.c:12:bar"), "query ignores the path");
+    test_assert(!matches("12", "foo.c:12:bar"), "query ignores the line number");
+    test_assert(!matches("3", "foo.c:12:3:bar"), "query ignores the column number");
+    test_assert(matches("call(x)", line), "query matches across color escapes");
+}
+
+void test_query_backend_patterns() {
+    line_list_t *patterns = line_list_init();
+    query_t *query = query_parse("!skip a|b first second", QUERY_MATCH_CASE);
+
+    query_backend_patterns(query, patterns);
+    test_assert(patterns->length == 1 && strcmp(patterns->lines[0], "first") == 0, "backend searches first single term clause");
+    query_deallocate(&query);
+
+    line_list_clear(patterns);
+    query = query_parse("a|b c|d", QUERY_MATCH_CASE);
+    query_backend_patterns(query, patterns);
+    test_assert(patterns->length == 2, "backend falls back to first OR clause");
+    query_deallocate(&query);
+
+    line_list_clear(patterns);
+    query = query_parse("!a !b", QUERY_MATCH_CASE);
+    query_backend_patterns(query, patterns);
+    test_assert(patterns->length == 1 && patterns->lines[0][0] == '\0', "backend searches every line for negated clauses only");
+    query_deallocate(&query);
+
+    line_list_clear(patterns);
+    query = query_parse("! |", QUERY_MATCH_CASE);
+    query_backend_patterns(query, patterns);
+    test_assert(patterns->length == 0, "backend has nothing to search for a query without clauses");
+    query_deallocate(&query);
+
+    line_list_deallocate(&patterns);
+}
+
+void test_query_case() {
+    query_t *query = query_parse("Foo !BAR", QUERY_IGNORE_CASE);
+    line_list_t *terms = line_list_init();
+
+    test_assert(query_matches_line(query, "f.c:1:FOO bar") == 0, "ignored case applies to negated terms");
+    test_assert(query_matches_line(query, "f.c:1:fOo baz") == 1, "ignored case matches either case");
+    query_backend_terms(query, terms);
+    test_assert(terms->length == 1 && strcmp(terms->lines[0], "foo") == 0, "ignored case sends lower case terms");
+    query_deallocate(&query);
+
+    query = query_parse("foo", QUERY_SMART_CASE);
+    test_assert(query_matches_line(query, "f.c:1:FOO") == 1, "smart case ignores case of a lower case query");
+    query_deallocate(&query);
+    query = query_parse("Foo", QUERY_SMART_CASE);
+    test_assert(query_matches_line(query, "f.c:1:foo") == 0, "smart case matches case once a letter is upper case");
+    query_deallocate(&query);
+    query = query_parse("Foo", QUERY_MATCH_CASE);
+    test_assert(query_matches_line(query, "f.c:1:FOO") == 0, "case is matched by default");
+    query_deallocate(&query);
+
+    line_list_deallocate(&terms);
+}
+
+void test_query_escape_term() {
+    char *escaped = query_escape_term("a.b*c\\d^e$");
+
+    test_assert(strcmp(escaped, "a[.]b[*]c\\\\d\\^e[$]") == 0, "escape_term makes metacharacters literal");
+    free(escaped);
+
+    escaped = query_escape_term("a[0]");
+    test_assert(strcmp(escaped, "a\\[0\\]") == 0, "escape_term backslash escapes brackets");
+    free(escaped);
+}
+
+int run_query_tests() {
+    reset_test_counters();
+    printf("Running query tests...\n");
+
+    test_query_parse_clauses();
+    test_query_parse_escapes();
+    test_query_parse_duplicates();
+    test_query_and();
+    test_query_or();
+    test_query_not();
+    test_query_ignores_prefix_and_color();
+    test_query_backend_patterns();
+    test_query_case();
+    test_query_escape_term();
+
+    printf("\nQuery tests completed: %d/%d passed\n", test_passed, test_count);
+    return (test_passed == test_count) ? 0 : 1;
+}
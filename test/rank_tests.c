@@ -0,0 +1,136 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include "rank.h"
+#include "line_list.h"
+#include "test_utils.h"
+
+#define MATCH(text) "\033[01;31m\033[K" text "\033[m\033[K"
+
+static void add(rank_t *rank, const char *line) {
+    rank_add(rank, line, strlen(line));
+}
+
+void test_path_score() {
+    rank_t *rank = rank_init(4);
+    char path[RANK_MAX_PATH + 8];
+
+    test_assert(rank_path_score(rank, "a.c") == rank_path_score(rank, "./a.c"), "./ does not count as a directory");
+    test_assert(rank_path_score(rank, "a.c") > rank_path_score(rank, "src/a.c"), "shallow paths score higher");
+    test_assert(rank_path_score(rank, "src/a.c") > rank_path_score(rank, "../a.c"), "leaving the directory costs more than entering one");
+    test_assert(rank_path_score(rank, "/nonexistent/a.c") < rank_path_score(rank, "a.c"), "absolute paths elsewhere score lower");
+    snprintf(path, sizeof(path), "%s/a.c", rank->cwd);
+    test_assert(rank_path_score(rank, path) == rank_path_score(rank, "a.c"), "absolute paths below the current directory are relative");
+
+    rank_deallocate(&rank);
+    test_assert(rank == NULL, "rank_deallocate resets the pointer");
+}
+
+void test_word_match_scores_higher() {
+    rank_t *rank = rank_init(4);
+
+    test_assert(rank_score(rank, "x.c:1:int " MATCH("main") "(void)") > rank_score(rank, "x.c:1:int " MATCH("main") "_loop(void)"),
+                "whole word matches score higher than substrings");
+    test_assert(rank_score(rank, "x.c:1:" MATCH("main")) > rank_score(rank, "x.c:1:do" MATCH("main")),
+                "matches at the line boundaries are whole words");
+
+    rank_deallocate(&rank);
+}
+
+void test_recent_files_score_higher() {
+    char dir[] = "/tmp/rtgrep_rank_testXXXXXX";
+    char old_path[256], new_path[256], old_line[300], new_line[300];
+    struct timespec times[2];
+    rank_t *rank;
+    FILE *f;
+
+    if (mkdtemp(dir) == NULL) {
+        test_assert(0, "create temporary rank directory");
+        return;
+    }
+    snprintf(old_path, sizeof(old_path), "%s/old.txt", dir);
+    snprintf(new_path, sizeof(new_path), "%s/new.txt", dir);
+    f = fopen(old_path, "w");
+    fclose(f);
+    f = fopen(new_path, "w");
+    fclose(f);
+    times[0].tv_sec = times[1].tv_sec = time(NULL) - 30 * 86400;
+    times[0].tv_nsec = times[1].tv_nsec = 0;
+    utimensat(AT_FDCWD, old_path, times, 0);
+
+    rank = rank_init(4);
+    snprintf(old_line, sizeof(old_line), "%s:1:text", old_path);
+    snprintf(new_line, sizeof(new_line), "%s:1:text", new_path);
+    test_assert(rank_score(rank, new_line) > rank_score(rank, old_line), "recently modified files score higher");
+    rank_deallocate(&rank);
+
+    unlink(old_path);
+    unlink(new_path);
+    rmdir(dir);
+}
+
+void test_keeps_best_k() {
+    rank_t *rank = rank_init(3);
+    line_list_t *lines = line_list_init();
+    char line[64];
+    int i;
+
+    // deeper paths score lower, so the shallowest three must survive
+    for (i = 6; i >= 0; i--) {
+        int depth;
+
+        line[0] = '\0';
+        for (depth = 0; depth < i; depth++) {
+            strcat(line, "d/");
+        }
+        snprintf(line + strlen(line), sizeof(line) - strlen(line), "f%d.c:1:x", i);
+        add(rank, line);
+    }
+    test_assert(rank->length == 3, "rank keeps at most K results");
+
+    rank_sorted(rank, lines);
+    test_assert(lines->length == 3, "rank_sorted returns every kept result");
+    test_assert(strcmp(lines->lines[2], "f0.c:1:x") == 0, "rank_sorted puts the best result last");
+    test_assert(strcmp(lines->lines[0], "d/d/f2.c:1:x") == 0, "rank_sorted puts the worst kept result first");
+
+    rank_clear(rank);
+    test_assert(rank->length == 0, "rank_clear drops every result");
+
+    line_list_deallocate(&lines);
+    rank_deallocate(&rank);
+}
+
+void test_ties_keep_arrival_order() {
+    rank_t *rank = rank_init(2);
+    line_list_t *lines = line_list_init();
+
+    add(rank, "a.c:1:first");
+    add(rank, "a.c:2:second");
+    add(rank, "a.c:3:third");
+    rank_sorted(rank, lines);
+
+    test_assert(lines->length == 2 && strcmp(lines->lines[1], "a.c:1:first") == 0
+                && strcmp(lines->lines[0], "a.c:2:second") == 0, "equal scores keep the earliest results");
+
+    line_list_deallocate(&lines);
+    rank_deallocate(&rank);
+}
+
+int run_rank_tests() {
+    reset_test_counters();
+    printf("Running rank tests...\n");
+
+    test_path_score();
+    test_word_match_scores_higher();
+    test_recent_files_score_higher();
+    test_keeps_best_k();
+    test_ties_keep_arrival_order();
+
+    printf("\nRank tests completed: %d/%d passed\n", test_passed, test_count);
+    return (test_passed == test_count) ? 0 : 1;
+}
@@ -0,0 +1,210 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "result_cache.h"
+#include "line_list.h"
+#include "test_utils.h"
+
+static char cache_tmp_dir[] = "/tmp/rtgrep_cache_testXXXXXX";
+static char tree_dir[64];     // files the cached results come from
+
+static void write_file(const char *path, const char *contents) {
+    FILE *f = fopen(path, "w");
+
+    fputs(contents, f);
+    fclose(f);
+}
+
+static void add_line(line_list_t *l, const char *line) {
+    line_list_add(l, strlen(line), (char *)line);
+}
+
+void test_cache_miss() {
+    char *path = result_cache_entry_path(cache_tmp_dir, "missing");
+
+    test_assert(result_cache_load(path, "missing") == NULL, "result_cache_load misses on absent entry");
+    free(path);
+}
+
+void test_cache_round_trip() {
+    char a[256], b[256], line_a[300], line_b[300];
+    char *key = result_cache_key("/root", "grep -rn", "hello");
+    char *path = result_cache_entry_path(cache_tmp_dir, key);
+    line_list_t *lines = line_list_init();
+    line_list_t *kept = line_list_init();
+    line_list_t *targets = line_list_init();
+    cache_listing_t *listing;
+    cache_entry_t *entry;
+
+    snprintf(a, sizeof(a), "%s/a.txt", tree_dir);
+    snprintf(b, sizeof(b), "%s/b.txt", tree_dir);
+    write_file(a, "hello\n");
+    write_file(b, "hello world\n");
+    snprintf(line_a, sizeof(line_a), "%s:1:hello", a);
+    snprintf(line_b, sizeof(line_b), "%s:1:hello world", b);
+    add_line(lines, line_a);
+    add_line(lines, line_b);
+    add_line(lines, "grep: something went wrong");
+
+    listing = result_cache_list(tree_dir);
+    test_assert(listing->file_count == 2, "result_cache_list finds every file");
+    test_assert(strcmp(listing->files[0].path, a) == 0 && strcmp(listing->files[1].path, b) == 0,
+                "result_cache_list sorts files by path");
+    test_assert(result_cache_store(path, key, lines, listing) == 0, "result_cache_store succeeds");
+    result_cache_listing_deallocate(&listing);
+    test_assert(listing == NULL, "result_cache_listing_deallocate sets pointer to NULL");
+
+    entry = result_cache_load(path, key);
+    test_assert(entry != NULL, "result_cache_load hits after store");
+    test_assert(entry && entry->listing.file_count == 2, "cache entry records the listing");
+    test_assert(entry && entry->lines->length == 3, "cache entry keeps every line");
+    test_assert(entry && strcmp(entry->lines->lines[1], line_b) == 0, "cache entry preserves line text");
+
+    listing = result_cache_list(tree_dir);
+    result_cache_compare(entry, listing, kept, targets);
+    test_assert(kept->length == 3 && targets->length == 0, "compare keeps all lines when nothing changed");
+    result_cache_listing_deallocate(&listing);
+
+    // grow b.txt so its size no longer matches, and add a new file
+    write_file(b, "hello world, again\n");
+    snprintf(line_b, sizeof(line_b), "%s/c.txt", tree_dir);
+    write_file(line_b, "new\n");
+    line_list_clear(kept);
+    listing = result_cache_list(tree_dir);
+    result_cache_compare(entry, listing, kept, targets);
+    test_assert(kept->length == 2, "compare drops lines from changed files");
+    test_assert(targets->length == 2 && strcmp(targets->lines[0], b) == 0 && strcmp(targets->lines[1], line_b) == 0,
+                "compare targets changed and new files");
+    result_cache_listing_deallocate(&listing);
+
+    // lines of a deleted file are dropped, and it is not searched
+    unlink(a);
+    line_list_clear(kept);
+    line_list_clear(targets);
+    listing = result_cache_list(tree_dir);
+    result_cache_compare(entry, listing, kept, targets);
+    test_assert(kept->length == 1, "compare drops lines from deleted files");
+    test_assert(targets->length == 2, "compare does not target deleted files");
+    result_cache_listing_deallocate(&listing);
+    result_cache_deallocate(&entry);
+    test_assert(entry == NULL, "result_cache_deallocate sets pointer to NULL");
+
+    unlink(b);
+    unlink(line_b);
+    unlink(path);
+    free(key);
+    free(path);
+    line_list_deallocate(&lines);
+    line_list_deallocate(&kept);
+    line_list_deallocate(&targets);
+}
+
+void test_cache_store_unlisted() {
+    char a[256], line[300];
+    char *key = result_cache_key("/root", "grep -rn", "x");
+    char *path = result_cache_entry_path(cache_tmp_dir, key);
+    cache_listing_t listing = {0};
+    line_list_t *lines = line_list_init();
+    cache_entry_t *entry;
+
+    snprintf(a, sizeof(a), "%s/a.txt", tree_dir);
+    snprintf(line, sizeof(line), "%s:1:x", a);
+    add_line(lines, line);
+    add_line(lines, "no path here");
+
+    // a.txt was created after the listing was taken
+    write_file(a, "x\n");
+    result_cache_store(path, key, lines, &listing);
+    entry = result_cache_load(path, key);
+    test_assert(entry && entry->lines->length == 1 && strcmp(entry->lines->lines[0], "no path here") == 0,
+                "result_cache_store leaves out lines of files missing from the listing");
+    result_cache_deallocate(&entry);
+
+    unlink(a);
+    unlink(path);
+    free(key);
+    free(path);
+    line_list_deallocate(&lines);
+}
+
+void test_cache_refresh() {
+    char a[256], line[300];
+    char *key = result_cache_key("/root", "grep -rn", "refresh");
+    char *path = result_cache_entry_path(cache_tmp_dir, key);
+    line_list_t *lines = line_list_init();
+    struct timespec pause = {0, 1000000};
+    cache_refresh_t *refresh;
+    cache_entry_t *entry;
+
+    snprintf(a, sizeof(a), "%s/a.txt", tree_dir);
+    write_file(a, "refresh\n");
+    snprintf(line, sizeof(line), "%s:1:refresh", a);
+    add_line(lines, line);
+
+    refresh = result_cache_refresh_start(tree_dir, NULL);
+    result_cache_refresh_store(refresh, path, key, lines);
+    result_cache_refresh_release(&refresh, 1);
+    test_assert(refresh == NULL, "result_cache_refresh_release sets pointer to NULL");
+
+    entry = result_cache_load(path, key);
+    test_assert(entry && entry->lines->length == 1, "a refresh writes the entry it was handed");
+    refresh = result_cache_refresh_start(tree_dir, entry);
+    while (!result_cache_refresh_poll(refresh)) {
+        nanosleep(&pause, NULL);
+    }
+    test_assert(refresh->kept->length == 1 && refresh->targets->length == 0,
+                "a refresh compares the listing with the entry");
+    result_cache_refresh_release(&refresh, 0);
+
+    unlink(a);
+    unlink(path);
+    free(key);
+    free(path);
+    line_list_deallocate(&lines);
+}
+
+void test_cache_key_mismatch() {
+    char *key = result_cache_key("/root", "grep -rn", "one");
+    char *other = result_cache_key("/root", "grep -rn", "two");
+    char *path = result_cache_entry_path(cache_tmp_dir, key);
+    cache_listing_t listing = {0};
+    line_list_t *lines = line_list_init();
+
+    add_line(lines, "x");
+    result_cache_store(path, key, lines, &listing);
+    test_assert(result_cache_load(path, other) == NULL, "result_cache_load rejects entry stored for another key");
+
+    unlink(path);
+    free(key);
+    free(other);
+    free(path);
+    line_list_deallocate(&lines);
+}
+
+int run_result_cache_tests() {
+    reset_test_counters();
+    printf("Running result_cache tests...\n");
+
+    if (mkdtemp(cache_tmp_dir) == NULL) {
+        test_assert(0, "create temporary cache directory");
+        return 1;
+    }
+    snprintf(tree_dir, sizeof(tree_dir), "%s/tree", cache_tmp_dir);
+    mkdir(tree_dir, 0700);
+
+    test_cache_miss();
+    test_cache_round_trip();
+    test_cache_store_unlisted();
+    test_cache_refresh();
+    test_cache_key_mismatch();
+
+    rmdir(tree_dir);
+    rmdir(cache_tmp_dir);
+
+    printf("\nResult cache tests completed: %d/%d passed\n", test_passed, test_count);
+    return (test_passed == test_count) ? 0 : 1;
+}
@@ -0,0 +1,188 @@
+#include <stdio.h>
+#include <string.h>
+#include "result_line.h"
+#include "test_utils.h"
+
+#define COLORED_LINE "\033[35m\033[Ksrc/main.c\033[m\033[K\033[36m\033[K:\033[m\033[K" \
+    "\033[32m\033[K12\033[m\033[K\033[36m\033[K:\033[m\033[Kint \033[01;31m\033[Kmain\033[m\033[K(void)"
+
+void test_strip_ansi_plain() {
+    char out[64];
+    size_t len = result_line_strip_ansi("file.c:3:hello", out, sizeof(out));
+
+    test_assert(len == 14, "strip_ansi keeps plain text length");
+    test_assert(strcmp(out, "file.c:3:hello") == 0, "strip_ansi leaves plain text unchanged");
+}
+
+void test_strip_ansi_colored() {
+    char out[64];
+
+    result_line_strip_ansi(COLORED_LINE, out, sizeof(out));
+    test_assert(strcmp(out, "src/main.c:12:int main(void)") == 0, "strip_ansi removes grep color escapes");
+}
+
+void test_strip_ansi_truncates() {
+    char out[5];
+    size_t len = result_line_strip_ansi("abcdefgh", out, sizeof(out));
+
+    test_assert(len == 4, "strip_ansi truncates to buffer size");
+    test_assert(strcmp(out, "abcd") == 0, "strip_ansi output is NUL terminated");
+}
+
+void test_path_plain() {
+    char path[64];
+    int len = result_line_path("./dir/file.txt:2:text", path, sizeof(path));
+
+    test_assert(len == 14, "result_line_path returns path length");
+    test_assert(strcmp(path, "./dir/file.txt") == 0, "result_line_path extracts plain path");
+}
+
+void test_path_colored() {
+    char path[64];
+
+    test_assert(result_line_path(COLORED_LINE, path, sizeof(path)) == 10, "result_line_path handles colored path");
+    test_assert(strcmp(path, "src/main.c") == 0, "result_line_path strips color from path");
+}
+
+void test_path_missing() {
+    char path[64];
+
+    test_assert(result_line_path("no separator here", path, sizeof(path)) == -1, "result_line_path rejects lines without ':'");
+    test_assert(result_line_path(":leading", path, sizeof(path)) == -1, "result_line_path rejects empty path");
+}
+
+void test_path_too_long() {
+    char path[4];
+
+    test_assert(result_line_path("longpath:1:x", path, sizeof(path)) == -1, "result_line_path rejects paths that do not fit");
+}
+
+void test_content() {
+    test_assert(strcmp(result_line_content("a.c:12:text"), "text") == 0, "result_line_content skips path and line number");
+    test_assert(strcmp(result_line_content("a.c:12:7:text"), "text") == 0, "result_line_content skips column number");
+    test_assert(strcmp(result_line_content("a.c:text:9:x"), "text:9:x") == 0, "result_line_content keeps non-numeric fields");
+    test_assert(strcmp(result_line_content("a.c:1:2:3:x"), "3:x") == 0, "result_line_content skips at most two numbers");
+    test_assert(strcmp(result_line_content("plain"), "plain") == 0, "result_line_content returns lines without path");
+}
+
+void test_number() {
+    test_assert(result_line_number("a.c:12:text") == 12, "result_line_number parses the line number");
+    test_assert(result_line_number(COLORED_LINE) == 12, "result_line_number handles colored lines");
+    test_assert(result_line_number("a.c:text:9") == -1, "result_line_number rejects non-numeric fields");
+    test_assert(result_line_number("a.c::x") == -1, "result_line_number rejects empty fields");
+    test_assert(result_line_number("plain") == -1, "result_line_number rejects lines without path");
+}
+
+/*
+ * Print line through result_line_print into out, returning the columns used.
+ */
+static int print_to_string(const char *line, int width, char *out, size_t out_size) {
+    FILE *f = tmpfile();
+    size_t len;
+    int columns;
+
+    columns = result_line_print(f, line, width);
+    rewind(f);
+    len = fread(out, 1, out_size - 1, f);
+    out[len] = '\0';
+    fclose(f);
+    return columns;
+}
+
+void test_print() {
+    char out[256];
+
+    test_assert(print_to_string("abcdef", 4, out, sizeof(out)) == 4, "result_line_print stops at width");
+    test_assert(strcmp(out, "abcd") == 0, "result_line_print clips the line");
+    print_to_string("a\tb", 10, out, sizeof(out));
+    test_assert(strcmp(out, "a b") == 0, "result_line_print prints tabs as a space");
+    test_assert(print_to_string("h\xc3\xa9llo", 3, out, sizeof(out)) == 3, "result_line_print counts UTF-8 characters");
+    test_assert(strcmp(out, "h\xc3\xa9l") == 0, "result_line_print keeps UTF-8 sequences whole");
+    print_to_string("\033[31m\033[Kab\033[m", 10, out, sizeof(out));
+    test_assert(strcmp(out, "\033[31mab\033[m") == 0, "result_line_print keeps colors and drops erase escapes");
+}
+
+void test_print_span() {
+    char out[256];
+    FILE *f = tmpfile();
+    size_t len;
+
+    test_assert(result_line_print_span(f, "abcdef", 3, 10) == 3, "result_line_print_span stops after len bytes");
+    rewind(f);
+    len = fread(out, 1, sizeof(out) - 1, f);
+    out[len] = '\0';
+    test_assert(strcmp(out, "abc") == 0, "result_line_print_span prints only the span");
+    fclose(f);
+}
+
+void test_content_offset() {
+    test_assert(result_line_content_offset("a.c:12:text") == 7, "result_line_content_offset skips path and line number");
+    test_assert(result_line_content_offset("a.c:12:7:text") == 9, "result_line_content_offset skips column number");
+    test_assert(result_line_content_offset("plain") == 0, "result_line_content_offset keeps lines without path");
+    test_assert(strcmp(COLORED_LINE + result_line_content_offset(COLORED_LINE), "\033[m\033[Kint \033[01;31m\033[Kmain\033[m\033[K(void)") == 0,
+                "result_line_content_offset handles colored lines");
+}
+
+void test_match_offset() {
+    size_t content = result_line_content_offset(COLORED_LINE);
+    long match = result_line_match_offset(COLORED_LINE, content);
+
+    test_assert(match > 0 && strncmp(COLORED_LINE + match, "\033[01;31m", 8) == 0,
+                "result_line_match_offset finds the first highlight");
+    test_assert(result_line_match_offset("a.c:1:\033[m\033[Kplain", 6) == -1, "result_line_match_offset ignores resets");
+}
+
+void test_visible_length() {
+    size_t content = result_line_content_offset(COLORED_LINE);
+    long match = result_line_match_offset(COLORED_LINE, content);
+
+    test_assert(result_line_visible_length("a.c:1:x", 4) == 4, "result_line_visible_length counts plain bytes");
+    test_assert(result_line_visible_length("a.c:1:x", 100) == 7, "result_line_visible_length stops at the end");
+    test_assert(result_line_visible_length(COLORED_LINE, content) == strlen("src/main.c:12:"),
+                "result_line_visible_length skips color escapes");
+    test_assert(result_line_visible_length(COLORED_LINE, match) == strlen("src/main.c:12:int "),
+                "result_line_visible_length maps the match to the stripped line");
+}
+
+void test_align() {
+    const char *line = "ab\033[01;31mcd\xc3\xa9" "f";
+
+    test_assert(result_line_align(line, 0, 1) == 1, "result_line_align keeps plain offsets");
+    test_assert(result_line_align(line, 0, 5) == 10, "result_line_align moves out of an escape");
+    test_assert(result_line_align(line, 0, 13) == 14, "result_line_align moves out of a UTF-8 character");
+}
+
+void test_match_is_word() {
+    test_assert(result_line_match_is_word("a.c:1:x \033[01;31mfoo\033[m y", 6) == 1,
+                "result_line_match_is_word accepts a match between spaces");
+    test_assert(result_line_match_is_word("a.c:1:\033[01;31mfoo\033[m", 6) == 1,
+                "result_line_match_is_word accepts a match spanning the whole content");
+    test_assert(result_line_match_is_word("a.c:1:x\033[01;31mfoo\033[mbar", 6) == 0,
+                "result_line_match_is_word rejects a match inside a word");
+    test_assert(result_line_match_is_word("a.c:1:plain", 6) == 0, "result_line_match_is_word needs a highlight");
+}
+
+int run_result_line_tests() {
+    reset_test_counters();
+    printf("Running result_line tests...\n");
+
+    test_strip_ansi_plain();
+    test_strip_ansi_colored();
+    test_strip_ansi_truncates();
+    test_path_plain();
+    test_path_colored();
+    test_path_missing();
+    test_path_too_long();
+    test_content();
+    test_number();
+    test_print();
+    test_print_span();
+    test_content_offset();
+    test_match_offset();
+    test_visible_length();
+    test_align();
+    test_match_is_word();
+
+    printf("\nResult line tests completed: %d/%d passed\n", test_passed, test_count);
+    return (test_passed == test_count) ? 0 : 1;
+}
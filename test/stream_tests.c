@@ -0,0 +1,235 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include "stream.h"
+#include "test_utils.h"
+
+#define COLORED_LINE "\033[35m\033[Ksrc/main.c\033[m\033[K\033[36m\033[K:\033[m\033[K" \
+    "\033[32m\033[K12\033[m\033[K\033[36m\033[K:\033[m\033[Kint \033[01;31m\033[Kmain\033[m\033[K(void)"
+
+/*
+ * Returns the events buffered so far as a string and clears the buffer,
+ * as if they had all been written
+ */
+static char* take(stream_t *stream, char *out, size_t size) {
+    size_t len = stream->length < size - 1 ? stream->length : size - 1;
+
+    memcpy(out, stream->buffer, len);
+    out[len] = '\0';
+    stream->length = 0;
+    stream->results_from = 0;
+    stream->partial = 0;
+    return out;
+}
+
+void test_generations() {
+    stream_t *stream = stream_init(-1);
+    char out[512];
+
+    stream_start(stream, "foo");
+    test_assert(strcmp(take(stream, out, sizeof(out)), "{\"event\":\"start\",\"generation\":1,\"pattern\":\"foo\"}\n") == 0,
+                "stream_start starts the first generation");
+    stream_done(stream);
+    test_assert(strcmp(take(stream, out, sizeof(out)), "{\"event\":\"done\",\"generation\":1,\"count\":0}\n") == 0,
+                "stream_done ends the generation");
+    stream_cancel(stream);
+    stream_done(stream);
+    test_assert(stream->length == 0, "an ended generation is not ended again");
+
+    stream_start(stream, "fo");
+    take(stream, out, sizeof(out));
+    stream_start(stream, "f");
+    test_assert(strcmp(take(stream, out, sizeof(out)),
+                       "{\"event\":\"cancelled\",\"generation\":2,\"count\":0}\n"
+                       "{\"event\":\"start\",\"generation\":3,\"pattern\":\"f\"}\n") == 0,
+                "a new generation cancels the unfinished one");
+
+    stream_restart(stream);
+    test_assert(stream->length == 0, "stream_restart keeps a generation without results");
+    stream_result(stream, "a.c:1:f", 7);
+    take(stream, out, sizeof(out));
+    stream_restart(stream);
+    test_assert(strcmp(take(stream, out, sizeof(out)),
+                       "{\"event\":\"cancelled\",\"generation\":3,\"count\":1}\n"
+                       "{\"event\":\"start\",\"generation\":4,\"pattern\":\"f\"}\n") == 0,
+                "stream_restart starts a generation with the same pattern");
+
+    stream_final(stream);
+    test_assert(strstr(take(stream, out, sizeof(out)),
+                       "{\"event\":\"start\",\"generation\":5,\"pattern\":\"f\",\"final\":true}\n") != NULL,
+                "stream_final starts a final generation with the last pattern");
+
+    stream_close(&stream);
+    test_assert(stream == NULL, "stream_close resets the pointer");
+}
+
+void test_results() {
+    stream_t *stream = stream_init(-1);
+    char out[512];
+
+    stream_result(stream, "a.c:1:x", 7);
+    test_assert(stream->length == 0, "results outside a generation are dropped");
+
+    stream_start(stream, "main");
+    take(stream, out, sizeof(out));
+
+    stream_result(stream, COLORED_LINE, strlen(COLORED_LINE));
+    test_assert(strcmp(take(stream, out, sizeof(out)),
+                       "{\"event\":\"result\",\"generation\":1,\"path\":\"src/main.c\",\"line\":12,\"column\":5,"
+                       "\"text\":\"int main(void)\"}\n") == 0,
+                "colored grep output is parsed and the column comes from the match");
+
+    stream_result(stream, "src/a.rs:3:9:fn main() {}xyz", 25);
+    test_assert(strstr(take(stream, out, sizeof(out)), "\"path\":\"src/a.rs\",\"line\":3,\"column\":9,\"text\":\"fn main() {}\"") != NULL,
+                "vimgrep columns are used as they are, only len bytes are sent");
+
+    stream_result(stream, "no separators here", 18);
+    test_assert(strstr(take(stream, out, sizeof(out)), "\"path\":\"\",\"line\":0,\"column\":0,\"text\":\"no separators here\"") != NULL,
+                "lines without a path keep their text");
+
+    stream_done(stream);
+    test_assert(strstr(take(stream, out, sizeof(out)), "\"count\":3}") != NULL, "done counts the results");
+
+    stream_close(&stream);
+}
+
+void test_cancel_drops_results() {
+    stream_t *stream = stream_init(-1);
+    char out[512];
+    size_t half;
+
+    stream_start(stream, "a");
+    stream_result(stream, "a.c:1:a", 7);
+    stream_result(stream, "a.c:2:a", 7);
+    stream_cancel(stream);
+    test_assert(strcmp(take(stream, out, sizeof(out)),
+                       "{\"event\":\"start\",\"generation\":1,\"pattern\":\"a\"}\n"
+                       "{\"event\":\"cancelled\",\"generation\":1,\"count\":0}\n") == 0,
+                "results of a cancelled generation that were not written are dropped");
+
+    // the reader has taken the start event and half of the first result
+    stream_start(stream, "b");
+    take(stream, out, sizeof(out));
+    stream_result(stream, "b.c:1:b", 7);
+    stream_result(stream, "b.c:2:b", 7);
+    half = strchr(stream->buffer, '\n') - stream->buffer;
+    half /= 2;
+    memmove(stream->buffer, stream->buffer + half, stream->length - half);
+    stream->length -= half;
+    stream->partial = 1;
+    stream_cancel(stream);
+    test_assert(strstr(take(stream, out, sizeof(out)), "\"line\":1,") != NULL && strstr(out, "\"line\":2,") == NULL
+                && strstr(out, "{\"event\":\"cancelled\",\"generation\":2,\"count\":1}\n") != NULL,
+                "a partly written result is completed, the rest are dropped");
+
+    stream_close(&stream);
+}
+
+void test_buffer_limit() {
+    stream_t *stream = stream_init(-1);
+    long sent = 0;
+
+    stream_start(stream, "x");
+    while (stream->active && sent < STREAM_MAX_BUFFER) {
+        stream_result(stream, "x.c:1:x", 7);
+        sent++;
+    }
+    test_assert(!stream->active && stream->length < STREAM_MAX_BUFFER + 512, "a reader that lags behind ends the generation");
+    test_assert(strstr(stream->buffer + stream->length - 64, "\"event\":\"truncated\"") != NULL,
+                "the generation ends with truncated");
+    test_assert(stream->count == sent - 1, "truncated counts the results the reader gets");
+
+    stream_close(&stream);
+}
+
+void test_escaping() {
+    stream_t *stream = stream_init(-1);
+    char out[512];
+
+    stream_start(stream, "say \"hi\"\\");
+    test_assert(strstr(take(stream, out, sizeof(out)), "\"pattern\":\"say \\\"hi\\\"\\\\\"") != NULL,
+                "quotes and backslashes are escaped");
+
+    stream_result(stream, "a.c:1:tab\there \xc3\xa9 \xff", 19);
+    test_assert(strstr(take(stream, out, sizeof(out)), "\"text\":\"tab\\u0009here \xc3\xa9 \\u00ff\"") != NULL,
+                "control characters and invalid UTF-8 are escaped, valid UTF-8 is kept");
+
+    stream_close(&stream);
+}
+
+void test_flush() {
+    stream_t *stream;
+    int pipefd[2];
+    char out[512];
+    ssize_t len;
+
+    if (pipe(pipefd) != 0) {
+        test_assert(0, "pipe for stream_flush");
+        return;
+    }
+    fcntl(pipefd[1], F_SETFL, fcntl(pipefd[1], F_GETFL) | O_NONBLOCK);
+    stream = stream_init(pipefd[1]);
+
+    stream_start(stream, "x");
+    test_assert(stream_pending(stream), "events are buffered until flushed");
+    test_assert(stream_flush(stream) == 0 && !stream_pending(stream), "stream_flush writes the events");
+    len = read(pipefd[0], out, sizeof(out) - 1);
+    out[len > 0 ? len : 0] = '\0';
+    test_assert(strcmp(out, "{\"event\":\"start\",\"generation\":1,\"pattern\":\"x\"}\n") == 0, "the reader gets the events");
+
+    // the reader going away is reported instead of killing the process
+    signal(SIGPIPE, SIG_IGN);
+    close(pipefd[0]);
+    stream_done(stream);
+    test_assert(stream_flush(stream) == -1, "stream_flush reports a closed reader");
+
+    stream_close(&stream);
+    signal(SIGPIPE, SIG_DFL);
+}
+
+void test_open() {
+    char path[] = "/tmp/rtgrep_stream_XXXXXX";
+    char out[512];
+    stream_t *stream;
+    FILE *f;
+    size_t len;
+    int fd = mkstemp(path);
+
+    close(fd);
+    stream = stream_open(path);
+    test_assert(stream != NULL, "stream_open opens a file");
+    stream_start(stream, "y");
+    stream_done(stream);
+    stream_close(&stream);
+
+    f = fopen(path, "r");
+    len = f ? fread(out, 1, sizeof(out) - 1, f) : 0;
+    out[len] = '\0';
+    if (f) {
+        fclose(f);
+    }
+    test_assert(strstr(out, "{\"event\":\"done\",\"generation\":1,\"count\":0}\n") != NULL, "stream_close writes what is left");
+    unlink(path);
+
+    test_assert(stream_open("/nonexistent/dir/stream") == NULL, "stream_open fails for a bad path");
+}
+
+int run_stream_tests() {
+    reset_test_counters();
+    printf("Running stream tests...\n");
+
+    test_generations();
+    test_results();
+    test_cancel_drops_results();
+    test_buffer_limit();
+    test_escaping();
+    test_flush();
+    test_open();
+
+    printf("\nStream tests completed: %d/%d passed\n", test_passed, test_count);
+    return (test_passed == test_count) ? 0 : 1;
+}
@@ -2,6 +2,17 @@
 
 int run_line_list_tests();
 int run_arguments_tests();
+int run_result_line_tests();
+int run_command_tests();
+int run_result_cache_tests();
+int run_aho_corasick_tests();
+int run_query_tests();
+int run_file_scan_tests();
+int run_preview_tests();
+int run_rank_tests();
+int run_fuzzy_tests();
+int run_governor_tests();
+int run_stream_tests();
 
 int main(int argc, char** argv) {
     printf("Running all tests...\n\n");
@@ -9,8 +20,34 @@ int main(int argc, char** argv) {
     int line_list_result = run_line_list_tests();
     printf("\n");
     int arguments_result = run_arguments_tests();
+    printf("\n");
+    int result_line_result = run_result_line_tests();
+    printf("\n");
+    int command_result = run_command_tests();
+    printf("\n");
+    int result_cache_result = run_result_cache_tests();
+    printf("\n");
+    int aho_corasick_result = run_aho_corasick_tests();
+    printf("\n");
+    int query_result = run_query_tests();
+    printf("\n");
+    int file_scan_result = run_file_scan_tests();
+    printf("\n");
+    int preview_result = run_preview_tests();
+    printf("\n");
+    int rank_result = run_rank_tests();
+    printf("\n");
+    int fuzzy_result = run_fuzzy_tests();
+    printf("\n");
+    int governor_result = run_governor_tests();
+    printf("\n");
+    int stream_result = run_stream_tests();
     
-    int total_result = line_list_result + arguments_result;
+    int total_result = line_list_result + arguments_result + result_line_result +
+                       command_result + result_cache_result + aho_corasick_result +
+                       query_result + file_scan_result + preview_result +
+                       rank_result + fuzzy_result + governor_result +
+                       stream_result;
     
     if (total_result == 0) {
         printf("\nAll tests passed!\n");